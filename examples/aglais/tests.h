@@ -20,9 +20,18 @@
 
 #include "Kaleidoscope-Simulator.h"
 #include "kaleidoscope_simulator/AglaisInterface.h"
+#include "kaleidoscope_simulator/AglaisBinary.h"
+#include "aglais/Consumer_.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
    
 KALEIDOSCOPE_SIMULATOR_INIT
 
@@ -31,8 +40,279 @@ namespace simulator {
    
 extern const char aglais_test_recording[];
    
+namespace {
+   
+// Decodes a binary document and returns the error message.
+//
+std::string decodeBinary(const std::string &binary)
+{
+   std::istringstream in(binary, std::ios::binary);
+   std::ostringstream text;
+   std::string error_message;
+   if(convertAglaisBinaryToText(in, text, &error_message)) {
+      return "";
+   }
+   return error_message;
+}
+
+/// @private
+/// @brief Records the events of an Aglais document and the chunks
+///        it is parsed in.
+///
+class EventRecorder : public aglais::Consumer_
+{
+   public:
+      
+      virtual void onFirmwareId(const char *firmware_id) override {
+         
+         // Every chunk starts with the document header.
+         //
+         ++n_chunks_;
+         chunk_start_ = true;
+      }
+      virtual void onStartCycle(uint32_t cycle_id, uint32_t cycle_start_time) override {
+         chunk_start_ = false;
+         events_ << "start_cycle " << cycle_id << ' ' << cycle_start_time << '\n';
+      }
+      virtual void onEndCycle(uint32_t cycle_id, uint32_t cycle_end_time) override {
+         this->checkInCycle();
+         events_ << "end_cycle " << cycle_id << ' ' << cycle_end_time << '\n';
+      }
+      virtual void onKeyPressed(uint8_t row, uint8_t col) override {
+         this->checkInCycle();
+         events_ << "key_pressed " << (int)row << ' ' << (int)col << '\n';
+      }
+      virtual void onKeyReleased(uint8_t row, uint8_t col) override {
+         this->checkInCycle();
+         events_ << "key_released " << (int)row << ' ' << (int)col << '\n';
+      }
+      virtual void onHIDReport(uint8_t id, int length, const uint8_t *data) override {
+         this->checkInCycle();
+         events_ << "hid_report " << (int)id << ' ' << length;
+         for(int i = 0; i < length; ++i) {
+            events_ << ' ' << (int)data[i];
+         }
+         events_ << '\n';
+      }
+      virtual void onSetTime(uint32_t time) override {
+         this->checkInCycle();
+         events_ << "set_time " << time << '\n';
+      }
+      virtual void onCycles(uint32_t start_cycle_id, uint32_t start_time_id, 
+                            const std::vector<uint32_t> &cycle_durations) override {
+         chunk_start_ = false;
+         events_ << "cycles " << start_cycle_id << ' ' << start_time_id;
+         for(auto duration: cycle_durations) {
+            events_ << ' ' << duration;
+         }
+         events_ << '\n';
+      }
+      
+      std::string getEvents() const { return events_.str(); }
+      int getNumChunks() const { return n_chunks_; }
+      bool getChunksSplitCycles() const { return chunks_split_cycles_; }
+      
+   private:
+      
+      // A chunk must start with start_cycle or cycles.
+      //
+      void checkInCycle() {
+         if(chunk_start_) { chunks_split_cycles_ = true; }
+      }
+      
+   private:
+      
+      std::ostringstream events_;
+      int n_chunks_ = 0;
+      bool chunk_start_ = false;
+      bool chunks_split_cycles_ = false;
+};
+
+// Counts the lines of an Aglais document that start a cycle.
+//
+int countCycleStarts(const char *document)
+{
+   std::istringstream in(document);
+   std::string line;
+   int n_cycle_starts = 0;
+   while(std::getline(in, line)) {
+      if((line.compare(0, 12, "start_cycle ") == 0)
+            || (line.compare(0, 7, "cycles ") == 0)) {
+         ++n_cycle_starts;
+      }
+   }
+   return n_cycle_starts;
+}
+
+// Replays an Aglais file in a child process and returns its exit status.
+// Replaying a document moves the simulator's time to the recorded 
+// times. A child process lets every replay start from the same state.
+//
+int replayAglaisFile(Simulator &simulator, const char *filename, 
+                     bool memory_map, std::size_t chunk_size)
+{
+   std::cout << std::flush;
+   std::fflush(stdout);
+   
+   pid_t pid = fork();
+   
+   if(pid == 0) {
+      
+      bool success = processAglaisFile(filename, simulator, memory_map, chunk_size);
+      
+      std::cout << std::flush;
+      std::fflush(stdout);
+      
+      _exit((success && (simulator.getErrorCount() == 0)) ? 0 : 1);
+   }
+   
+   int status = 0;
+   waitpid(pid, &status, 0);
+   
+   return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+} // namespace
+
+void runStreamingTests(Simulator &simulator) {
+   
+   {
+      auto test = simulator.newTest("Aglais document parsed in chunks");
+      
+      std::istringstream recording(aglais_test_recording);
+      EventRecorder single_chunk;
+      parseAglaisDocument(recording, single_chunk);
+      
+      PAPILIO_ASSERT_CONDITION(simulator, single_chunk.getNumChunks() == 1);
+      
+      // With a chunk size of one byte, every cycle starts a new chunk.
+      //
+      std::istringstream recording_2(aglais_test_recording);
+      EventRecorder chunks;
+      parseAglaisDocument(recording_2, chunks, 1 /* chunk size */);
+      
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         chunks.getNumChunks() == countCycleStarts(aglais_test_recording));
+      PAPILIO_ASSERT_CONDITION(simulator, !chunks.getChunksSplitCycles());
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         chunks.getEvents() == single_chunk.getEvents());
+   }
+   
+   {
+      auto test = simulator.newTest("Aglais file replay");
+      
+      char filename[] = "/tmp/kaleidoscope_simulator_aglais_XXXXXX";
+      int fd = mkstemp(filename);
+      PAPILIO_ASSERT_CONDITION(simulator, fd >= 0);
+      if(fd < 0) { return; }
+      
+      std::size_t size = std::strlen(aglais_test_recording);
+      bool written = (write(fd, aglais_test_recording, size) == static_cast<ssize_t>(size));
+      close(fd);
+      
+      PAPILIO_ASSERT_CONDITION(simulator, written);
+      
+      if(written) {
+         PAPILIO_ASSERT_CONDITION(simulator, 
+            replayAglaisFile(simulator, filename, false /* stream */, 256) == 0);
+         PAPILIO_ASSERT_CONDITION(simulator, 
+            replayAglaisFile(simulator, filename, true /* memory map */, 256) == 0);
+      }
+      
+      unlink(filename);
+   }
+}
+
+void runBinaryRoundTripTests(Simulator &simulator) {
+   
+   {
+      auto test = simulator.newTest("Aglais text to binary to text");
+      
+      // Normalize the formatting of the text document.
+      //
+      std::istringstream recording(aglais_test_recording);
+      std::ostringstream text;
+      AglaisTextEncoder text_encoder(text);
+      parseAglaisDocument(recording, text_encoder);
+      
+      std::istringstream recording_2(aglais_test_recording);
+      std::ostringstream binary(std::ios::binary);
+      convertAglaisTextToBinary(recording_2, binary);
+      
+      std::istringstream binary_in(binary.str(), std::ios::binary);
+      std::ostringstream round_trip_text;
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         convertAglaisBinaryToText(binary_in, round_trip_text));
+      
+      PAPILIO_ASSERT_CONDITION(simulator, round_trip_text.str() == text.str());
+      
+      // Encoding the result again yields the same binary document.
+      //
+      std::istringstream round_trip_in(round_trip_text.str());
+      std::ostringstream round_trip_binary(std::ios::binary);
+      convertAglaisTextToBinary(round_trip_in, round_trip_binary);
+      
+      PAPILIO_ASSERT_CONDITION(simulator, round_trip_binary.str() == binary.str());
+   }
+   
+   {
+      auto test = simulator.newTest("Corrupt binary Aglais documents");
+      
+      using namespace std::string_literals;
+      
+      const auto header = "AGLB\x01"s;
+      
+      PAPILIO_ASSERT_CONDITION(simulator, decodeBinary(header).empty());
+      
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary("AGLX\x01"s) == "Not a binary Aglais document");
+      
+      // A start_cycle record that lacks its time.
+      //
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x02\x05"s) == "Truncated binary Aglais document");
+      
+      // A HID report and a firmware id whose lengths (2^32 - 1) exceed 
+      // the limits. Nothing must be allocated for those.
+      //
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x06\x01\xFF\xFF\xFF\xFF\x0F"s) 
+            == "Truncated binary Aglais document");
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x01\xFF\xFF\xFF\xFF\x0F"s) 
+            == "Truncated binary Aglais document");
+      
+      // A keyboard report that is shorter than the keyboard report data 
+      // and a report of an unregistered type.
+      //
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x06\x08\x02\x00\x00"s) 
+            == "Invalid HID report in binary Aglais document");
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x06\x03\x00"s) 
+            == "Invalid HID report in binary Aglais document");
+      
+      // A cycles record that announces 2^24 durations but ends early.
+      //
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x08\x00\x00\x80\x80\x80\x08\x01\x01"s) 
+            == "Truncated binary Aglais document");
+      
+      // A set_time record whose varint has bits beyond 32 bits set.
+      //
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x07\xFF\xFF\xFF\xFF\x1F"s) 
+            == "Truncated binary Aglais document");
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         decodeBinary(header + "\x07\xFF\xFF\xFF\xFF\x0F"s).empty());
+   }
+}
+
 void runSimulator(Simulator &simulator) {
    
+   runBinaryRoundTripTests(simulator);
+   runStreamingTests(simulator);
+   
    using namespace actions;
    
    //simulator.setQuiet();
@@ -0,0 +1,156 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+
+#include "Kaleidoscope-Simulator.h"
+#include "kaleidoscope_simulator/AglaisInterface.h"
+#include "kaleidoscope_simulator/Benchmark.h"
+   
+KALEIDOSCOPE_SIMULATOR_INIT
+
+namespace kaleidoscope {
+namespace simulator {
+   
+extern const char aglais_test_recording[];
+extern const char benchmark_baseline[];
+
+// The letter block of the Model01, both halves.
+//
+static const uint8_t letter_keys[][2] = {
+   {1, 1}, {1, 2}, {1, 3}, {1, 4}, {1, 5}, 
+   {2, 1}, {2, 2}, {2, 3}, {2, 4}, {2, 5}, 
+   {3, 1}, {3, 2}, {3, 3}, {3, 4}, {3, 5},
+   {1, 10}, {1, 11}, {1, 12}, {1, 13}, {1, 14}, 
+   {2, 10}, {2, 11}, {2, 12}, {2, 13}, {2, 14}, 
+   {3, 10}, {3, 11}, {3, 12}, {3, 13}, {3, 14}
+};
+
+static constexpr int n_letter_keys = sizeof(letter_keys)/sizeof(letter_keys[0]);
+
+static constexpr int n_idle_cycles = 1000;
+   
+void runSimulator(Simulator &simulator) {
+   
+   Benchmark benchmark(simulator);
+   
+   // Checks reports per keystroke by default. Cycle times are only
+   // checked against a baseline file that is passed through 
+   // KALEIDOSCOPE_SIMULATOR_BENCHMARK_BASELINE.
+   //
+   benchmark.setBaseline(benchmark_baseline);
+   
+   benchmark.addScenario("idle",
+      [&]() { simulator.cycles(n_idle_cycles); },
+      [&]() { LEDOff.activate(); }
+   );
+   
+   benchmark.addScenario("typing burst", n_letter_keys,
+      [&]() {
+         for(const auto &key: letter_keys) {
+            simulator.pressKey(key[0], key[1]);
+            simulator.cycle();
+            simulator.releaseKey(key[0], key[1]);
+            simulator.cycle();
+         }
+      }
+   );
+   
+   benchmark.addScenario("full rollover", n_letter_keys,
+      [&]() {
+         KeyMatrixBitset keys;
+         for(const auto &key: letter_keys) {
+            keys.set(SimulatorCore::keyIndex(key[0], key[1]));
+         }
+         simulator.applyKeyStates(keys);
+         simulator.cycles(10);
+         simulator.applyKeyStates(KeyMatrixBitset{}, keys);
+         simulator.cycles(10);
+      }
+   );
+   
+#define BENCHMARK_LED_EFFECT(EFFECT)                                           \
+   benchmark.addScenario("LED effect " #EFFECT,                                \
+      [&]() { simulator.cycles(n_idle_cycles); },                              \
+      [&]() { EFFECT.activate(); }                                             \
+   );
+   
+   BENCHMARK_LED_EFFECT(LEDRainbowEffect)
+   BENCHMARK_LED_EFFECT(LEDRainbowWaveEffect)
+   BENCHMARK_LED_EFFECT(LEDChaseEffect)
+   BENCHMARK_LED_EFFECT(solidRed)
+   BENCHMARK_LED_EFFECT(LEDBreatheEffect)
+   BENCHMARK_LED_EFFECT(AlphaSquareEffect)
+   BENCHMARK_LED_EFFECT(StalkerEffect)
+   BENCHMARK_LED_EFFECT(ColormapEffect)
+   
+#undef BENCHMARK_LED_EFFECT
+   
+   // Every sample replays the same recording. Its reports are only 
+   // valid for the firmware state at the start of the recording,
+   // which is not restored between samples. Thus, only the input is 
+   // replayed, relative to the current time.
+   //
+   benchmark.addScenario("Aglais replay",
+      [&]() { 
+         processAglaisDocument(aglais_test_recording, simulator, 
+                               AglaisReplay::input_only); 
+      },
+      [&]() { LEDOff.activate(); }
+   );
+   
+   // Measures the cost of translating reports to host events. The events
+   // are only counted, which does not require an X server. 
+   // As the host event actions remain registered, this must be 
+   // the last scenario.
+   //
+   auto host_event_backend 
+      = std::make_shared<RecordingHostEventBackend>(false /* record */);
+   
+   benchmark.addScenario("typing burst with host events", n_letter_keys,
+      [&]() {
+         for(const auto &key: letter_keys) {
+            simulator.pressKey(key[0], key[1]);
+            simulator.cycle();
+            simulator.releaseKey(key[0], key[1]);
+            simulator.cycle();
+         }
+      },
+      [&]() {
+         using namespace actions;
+         HostEventAction::setBackend(host_event_backend);
+         simulator.permanentBootKeyboardReportActions().add(GenerateHostEvent<BootKeyboardReport>{});
+         simulator.permanentKeyboardReportActions().add(GenerateHostEvent<KeyboardReport>{});
+      }
+   );
+   
+   benchmark.run();
+}
+
+const char aglais_test_recording[] =
+#include "../aglais/IO_protocoll.agl"
+;
+
+const char benchmark_baseline[] =
+#include "baseline.txt"
+;
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
@@ -0,0 +1,157 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+
+#include "Kaleidoscope-Simulator.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+   
+KALEIDOSCOPE_SIMULATOR_INIT
+
+namespace kaleidoscope {
+namespace simulator {
+   
+namespace {
+   
+/// @private
+///
+struct PassRecord {
+   int restore_count;
+   uint8_t state_restored;
+};
+
+// Creates a checkpoint and restores it twice. The pass 
+// with the given restore count reports an error.
+//
+// A checkpoint turns the calling process into its keeper, which 
+// terminates with the combined exit status of all passes. We therefore
+// run the passes in a child process and return its exit status. 
+// The passes are returned through a pipe.
+//
+int runPasses(Simulator &simulator, 
+              int failing_pass, 
+              std::vector<PassRecord> &passes)
+{
+   int fds[2];
+   if(pipe(fds) != 0) { return -1; }
+   
+   std::cout << std::flush;
+   std::fflush(stdout);
+   
+   pid_t pid = fork();
+   
+   if(pid == 0) {
+      
+      close(fds[0]);
+      
+      simulator.advanceTimeBy(100);
+      auto checkpoint_time = simulator.getTime();
+      
+      auto cp = simulator.checkpoint();
+      
+      int restore_count = simulator.getRestoreCount(cp);
+      
+      PassRecord record{
+         restore_count,
+         static_cast<uint8_t>(simulator.getTime() == checkpoint_time)
+      };
+      
+      if(write(fds[1], &record, sizeof(record)) != sizeof(record)) {
+         _exit(2);
+      }
+      
+      // Every pass modifies the state. The next pass must not see that.
+      //
+      simulator.advanceTimeBy(1000);
+      
+      if(restore_count == failing_pass) {
+         simulator.error() << "Intentional error in pass " << restore_count;
+      }
+      
+      if(restore_count < 2) {
+         simulator.restore(cp);
+      }
+      
+      std::cout << std::flush;
+      std::fflush(stdout);
+      
+      _exit((simulator.getErrorCount() > 0) ? 1 : 0);
+   }
+   
+   close(fds[1]);
+   
+   PassRecord record;
+   while(read(fds[0], &record, sizeof(record)) == sizeof(record)) {
+      passes.push_back(record);
+   }
+   close(fds[0]);
+   
+   int status = 0;
+   waitpid(pid, &status, 0);
+   
+   return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+void checkPasses(Simulator &simulator, const std::vector<PassRecord> &passes)
+{
+   PAPILIO_ASSERT_CONDITION(simulator, passes.size() == 3);
+   
+   for(std::size_t i = 0; i < passes.size(); ++i) {
+      PAPILIO_ASSERT_CONDITION(simulator, passes[i].restore_count == static_cast<int>(i));
+      PAPILIO_ASSERT_CONDITION(simulator, passes[i].state_restored);
+   }
+}
+
+} // namespace
+   
+void runSimulator(Simulator &simulator) {
+   
+   {
+      auto test = simulator.newTest("Checkpoint restored twice");
+      
+      std::vector<PassRecord> passes;
+      int exit_status = runPasses(simulator, -1 /* no failing pass */, passes);
+      
+      checkPasses(simulator, passes);
+      PAPILIO_ASSERT_CONDITION(simulator, exit_status == 0);
+   }
+   
+   {
+      auto test = simulator.newTest("Checkpoint with a failing pass");
+      
+      // An error in a pass that is followed by a restore must 
+      // not be lost.
+      //
+      std::vector<PassRecord> passes;
+      int exit_status = runPasses(simulator, 1 /* failing pass */, passes);
+      
+      checkPasses(simulator, passes);
+      PAPILIO_ASSERT_CONDITION(simulator, exit_status == 1);
+   }
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
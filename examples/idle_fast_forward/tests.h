@@ -0,0 +1,183 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+
+#include "Kaleidoscope-Simulator.h"
+
+#include <vector>
+   
+KALEIDOSCOPE_SIMULATOR_INIT
+
+namespace kaleidoscope {
+namespace simulator {
+   
+namespace {
+   
+/// @private
+///
+struct IdleRun {
+   int n_idle_cycles;
+   uint32_t press_report_delay;
+   uint32_t release_report_delay;
+   uint32_t timeout_delay;
+};
+
+/// @private
+/// @brief A timeout that is started when a key is released, like 
+///        the timeouts of OneShot or Qukeys.
+///
+struct ReleaseTimeout {
+   bool armed = false;
+   uint32_t deadline = 0;
+   uint32_t expiry_time = 0;
+   bool expired = false;
+};
+
+// Waits through a long idle period, then holds a key for a while. 
+// Returns the number of scan cycles of the idle period, the delays
+// of the key's reports and the delay of the timeout that is started 
+// when the key is released.
+//
+IdleRun runIdlePeriod(Simulator &simulator, 
+                      std::vector<uint32_t> &report_times,
+                      ReleaseTimeout &timeout,
+                      bool fast_forward)
+{
+   simulator.setIdleFastForward(fast_forward);
+   
+   // The timeout is not visible to the simulator. Fast-forwarding 
+   // must not skip past it.
+   //
+   simulator.setIdleFastForwardDeadline(
+      [&timeout](uint32_t &deadline) -> bool {
+         deadline = timeout.deadline;
+         return timeout.armed;
+      }
+   );
+   
+   IdleRun run{};
+   
+   auto start_cycle = simulator.getCurrentCycle();
+   simulator.advanceTimeBy(10000);
+   run.n_idle_cycles = simulator.getCurrentCycle() - start_cycle;
+   
+   report_times.clear();
+   
+   // The key is pressed while the firmware is idle. Its report must 
+   // not be delayed by a time step.
+   //
+   auto press_time = simulator.getTime();
+   simulator.pressKey(2, 1); // A
+   simulator.advanceTimeBy(1000);
+   
+   auto release_time = simulator.getTime();
+   simulator.releaseKey(2, 1);
+   
+   timeout.armed = true;
+   timeout.expired = false;
+   timeout.deadline = release_time + 333;
+   
+   simulator.advanceTimeBy(1000);
+   
+   PAPILIO_ASSERT_CONDITION(simulator, report_times.size() == 2);
+   PAPILIO_ASSERT_CONDITION(simulator, timeout.expired);
+   
+   if(report_times.size() == 2) {
+      run.press_report_delay = report_times[0] - press_time;
+      run.release_report_delay = report_times[1] - release_time;
+   }
+   
+   run.timeout_delay = timeout.expiry_time - release_time;
+   
+   simulator.setIdleFastForward(false);
+   simulator.setIdleFastForwardDeadline(std::function<bool(uint32_t &)>{});
+   
+   return run;
+}
+
+} // namespace
+   
+void runSimulator(Simulator &simulator) {
+   
+   using namespace papilio::actions;
+   using namespace papilio;
+   
+   auto test = simulator.newTest("Idle fast-forward");
+   
+   LEDOff.activate();
+   
+   std::vector<uint32_t> report_times;
+   
+   simulator.permanentReportActions().add(
+      CustomReportAction<Report_>{
+         [&](const Report_ &) -> bool {
+            report_times.push_back(simulator.getTime());
+            return true;
+         }
+      }
+   );
+   
+   // The timeout expires in the first cycle that starts after its deadline.
+   //
+   ReleaseTimeout timeout;
+   
+   simulator.permanentCycleActions().add(
+      CustomAction{
+         [&]() -> bool {
+            if(timeout.armed && (simulator.getTime() >= timeout.deadline)) {
+               timeout.armed = false;
+               timeout.expired = true;
+               timeout.expiry_time = simulator.getTime();
+            }
+            return true;
+         }
+      }
+   );
+   
+   // The reports are recorded by a permanent report action. Queueing 
+   // report actions would prevent fast-forwarding.
+   //
+   auto rwqa_state = simulator.getErrorIfReportWithoutQueuedActions();
+   simulator.setErrorIfReportWithoutQueuedActions(false);
+   
+   auto stepped = runIdlePeriod(simulator, report_times, timeout, 
+                                false /* fast-forward */);
+   auto fast_forwarded = runIdlePeriod(simulator, report_times, timeout, 
+                                       true /* fast-forward */);
+   
+   simulator.setErrorIfReportWithoutQueuedActions(rwqa_state);
+   
+   simulator.log() << "Idle cycles: " << stepped.n_idle_cycles << " stepped, "
+      << fast_forwarded.n_idle_cycles << " fast-forwarded";
+   
+   PAPILIO_ASSERT_CONDITION(simulator, 
+      10*fast_forwarded.n_idle_cycles < stepped.n_idle_cycles);
+   
+   PAPILIO_ASSERT_CONDITION(simulator, 
+      fast_forwarded.press_report_delay == stepped.press_report_delay);
+   PAPILIO_ASSERT_CONDITION(simulator, 
+      fast_forwarded.release_report_delay == stepped.release_report_delay);
+   PAPILIO_ASSERT_CONDITION(simulator, 
+      fast_forwarded.timeout_delay == stepped.timeout_delay);
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
@@ -0,0 +1,115 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+
+#include "Kaleidoscope-Simulator.h"
+
+#include <cstdio>
+#include <iostream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+   
+KALEIDOSCOPE_SIMULATOR_INIT
+
+namespace kaleidoscope {
+namespace simulator {
+   
+namespace {
+   
+// Registers tests that tap keys (row = 2, col = 1) -> A and 
+// (row = 3, col = 5) -> B. If with_failure is true, one of the tests
+// expects the wrong keycode.
+//
+void addTests(Simulator &simulator, ParallelTestRunner &runner, bool with_failure)
+{
+   using namespace actions;
+   using namespace papilio::actions;
+   
+   for(int i = 0; i < 4; ++i) {
+      runner.addTest("Tap A", [&simulator]() {
+         simulator.tapKey(2, 1); // A
+         simulator.cycleExpectReports(AssertKeycodesActive{Key_A});
+         simulator.cycleExpectReports(AssertReportEmpty{});
+      });
+      runner.addTest("Tap B", [&simulator]() {
+         simulator.tapKey(3, 5); // B
+         simulator.cycleExpectReports(AssertKeycodesActive{Key_B});
+         simulator.cycleExpectReports(AssertReportEmpty{});
+      });
+   }
+   
+   if(with_failure) {
+      runner.addTest("Intentionally failing", [&simulator]() {
+         simulator.tapKey(2, 1); // A
+         simulator.cycleExpectReports(AssertKeycodesActive{Key_B});
+         simulator.cycleExpectReports(AssertReportEmpty{});
+      });
+   }
+}
+
+} // namespace
+   
+void runSimulator(Simulator &simulator) {
+   
+   {
+      auto test = simulator.newTest("Parallel tests passing");
+      
+      ParallelTestRunner runner{simulator};
+      addTests(simulator, runner, false /* with failure */);
+      
+      PAPILIO_ASSERT_CONDITION(simulator, runner.run(3 /* workers */));
+   }
+   
+   {
+      auto test = simulator.newTest("Parallel tests with a failure");
+      
+      // A failing test is reported as an error by the runner. 
+      // We run it in a child process, so that the error does not
+      // count as a failure of this example.
+      //
+      std::cout << std::flush;
+      std::fflush(stdout);
+      
+      pid_t pid = fork();
+      
+      if(pid == 0) {
+         ParallelTestRunner runner{simulator};
+         addTests(simulator, runner, true /* with failure */);
+         
+         bool passed = runner.run(3 /* workers */);
+         
+         std::cout << std::flush;
+         std::fflush(stdout);
+         
+         _exit(passed ? 0 : 1);
+      }
+      
+      int status = 0;
+      waitpid(pid, &status, 0);
+      
+      PAPILIO_ASSERT_CONDITION(simulator, WIFEXITED(status));
+      PAPILIO_ASSERT_CONDITION(simulator, WEXITSTATUS(status) == 1);
+   }
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
@@ -0,0 +1,97 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+
+#include "Kaleidoscope-Simulator.h"
+   
+KALEIDOSCOPE_SIMULATOR_INIT
+
+namespace kaleidoscope {
+namespace simulator {
+   
+namespace {
+   
+// Checks the hook statistics of a profiled plugin.
+//
+template<typename _ProfiledPlugin>
+void checkProfile(Simulator &simulator, 
+                  const _ProfiledPlugin &plugin,
+                  int n_cycles)
+{
+   using namespace profiling;
+   
+   const auto &profiler = HookProfiler::getInstance();
+   
+   for(int i = 0; i < static_cast<int>(Hook::n_hooks); ++i) {
+      
+      auto hook = static_cast<Hook>(i);
+      const auto &stats = profiler.getHookStatistics(plugin.getPluginId(), hook);
+      
+      // Hooks that the plugin doesn't override are not timed.
+      //
+      if(!_ProfiledPlugin::overrides(hook)) {
+         PAPILIO_ASSERT_CONDITION(simulator, stats.getNumSamples() == 0);
+         continue;
+      }
+      
+      // The scan cycle hooks are called once per cycle.
+      //
+      if((hook == Hook::beforeEachCycle)
+            || (hook == Hook::beforeReportingState)
+            || (hook == Hook::afterEachCycle)) {
+         PAPILIO_ASSERT_CONDITION(simulator, 
+            stats.getNumSamples() == static_cast<uint64_t>(n_cycles));
+      }
+   }
+}
+
+} // namespace
+   
+void runSimulator(Simulator &simulator) {
+   
+   using namespace actions;
+   
+   auto test = simulator.newTest("Profiled plugins");
+   
+   // LEDControl and MouseKeys are profiled by the sketch as 
+   // this example defines KALEIDOSCOPE_SIMULATOR_PROFILE_PLUGINS 
+   // (see cflags).
+   //
+   profiling::HookProfiler::getInstance().reset();
+   
+   auto start_cycle = simulator.getCurrentCycle();
+   
+   simulator.tapKey(2, 1); // A
+   simulator.cycleExpectReports(AssertKeycodesActive{Key_A});
+   simulator.cycleExpectReports(AssertReportEmpty{});
+   
+   simulator.cycles(10);
+   
+   int n_cycles = simulator.getCurrentCycle() - start_cycle;
+   
+   checkProfile(simulator, LEDControl_profiled, n_cycles);
+   checkProfile(simulator, MouseKeys_profiled, n_cycles);
+   
+   // The statistics are logged when this function returns.
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
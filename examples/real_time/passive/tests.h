@@ -42,10 +42,20 @@ void runSimulator(Simulator &simulator) {
    
    std::cout << clear_screen << std::flush;
    
+   // The template is parsed once. Every frame only updates the keys
+   // whose label or LED color changed.
+   //
+   KeyboardTemplate keyboard_template(keyboardio::model01::ascii_keyboard);
+   KeyboardRenderer renderer(keyboard_template);
+   
+   // Terminal output happens on a separate thread at 30 frames per second.
+   // It does not slow down the simulation.
+   //
+   RenderThread render_thread(renderer, std::cout, 30.0);
+   
    simulator.runRealtime(10000, // 50000 cycles
       [&]() {
-         std::cout << cursor_to_upper_left << std::flush;
-         renderKeyboard(simulator, keyboardio::model01::ascii_keyboard);
+         render_thread.publish(simulator);
       }
    );
 }
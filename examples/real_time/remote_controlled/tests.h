@@ -26,12 +26,25 @@
 #include "kaleidoscope_simulator/reports/MouseReport.h"
 #include "kaleidoscope_simulator/reports/AbsoluteMouseReport.h"
 
+#include <cstring>
 #include <iostream>
    
 const char *executable_name = nullptr;
 
+// Set by the command line option --binary-input <path>. Enables 
+// event-driven input in the binary key event format of RemoteKeyInput,
+// read from a serial device, a FIFO or stdin (path "-").
+//
+const char *binary_input_path = nullptr;
+
 void parseCommandLine(int argc, char* argv[]) { 
    executable_name = argv[0];
+   
+   for(int i = 1; i < argc - 1; ++i) {
+      if(std::strcmp(argv[i], "--binary-input") == 0) {
+         binary_input_path = argv[i + 1];
+      }
+   }
 }
    
 KALEIDOSCOPE_SIMULATOR_INIT
@@ -49,6 +62,11 @@ void runSimulator(Simulator &simulator) {
    simulator.permanentKeyboardReportActions().add(GenerateHostEvent<KeyboardReport>{});
    simulator.permanentMouseReportActions().add(GenerateHostEvent<MouseReport>{});
    simulator.permanentAbsoluteMouseReportActions().add(GenerateHostEvent<AbsoluteMouseReport>{});
+   
+   // Send host events once per cycle instead of once per report.
+   //
+   HostEventAction::setFlushPolicy(HostEventAction::FlushPolicy::explicit_only);
+   simulator.permanentCycleActions().add(FlushHostEvents{});
 
    // Check out https://github.com/CapeLeidokos/Kaleidoscope-Simulator-Control
          
@@ -61,7 +79,39 @@ void runSimulator(Simulator &simulator) {
                         1 /* num. cycles after each tap */
    );
 
-   simulator.permanentReportActions().add(DumpReport{});
+   // Reports are not dumped. The keyboard renderer only repaints keys
+   // that changed, so log output that scrolls the terminal would
+   // shift the rendered keyboard for good.
+   
+   if(binary_input_path) {
+      
+      std::unique_ptr<RemoteKeyInput> input{
+         (std::strcmp(binary_input_path, "-") == 0) 
+            ? new RemoteKeyInput{}
+            : new RemoteKeyInput{binary_input_path}
+      };
+      
+      if(!input->good()) {
+         simulator.error() << "Unable to open binary input " << binary_input_path;
+         return;
+      }
+      
+      std::cout << clear_screen << std::flush;
+      
+      KeyboardTemplate keyboard_template(keyboardio::model01::ascii_keyboard);
+      KeyboardRenderer renderer(keyboard_template);
+      RenderThread render_thread(renderer, std::cout, 30.0);
+      
+      // Log output is written by the render thread, between frames.
+      //
+      render_thread.installLog(std::cout);
+      
+      simulator.runRemoteControlled(*input,
+         [&]() { render_thread.publish(simulator); }
+      );
+      
+      return;
+   }
    
    std::cout << clear_screen << std::flush;
    std::cout << cursor_to_upper_left << std::flush;
@@ -98,10 +148,17 @@ void runSimulator(Simulator &simulator) {
    
    std::cout << clear_screen << std::flush;
    
+   KeyboardTemplate keyboard_template(keyboardio::model01::ascii_keyboard);
+   KeyboardRenderer renderer(keyboard_template);
+   RenderThread render_thread(renderer, std::cout, 30.0);
+   
+   // Log output is written by the render thread, between frames.
+   //
+   render_thread.installLog(std::cout);
+   
    simulator.runRemoteControlled( 
        [&]() {
-         std::cout << cursor_to_upper_left << std::flush;
-         renderKeyboard(simulator, keyboardio::model01::ascii_keyboard);
+         render_thread.publish(simulator);
        },
        false
     );
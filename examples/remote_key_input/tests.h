@@ -0,0 +1,176 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+
+#include "Kaleidoscope-Simulator.h"
+#include "kaleidoscope_simulator/RemoteKeyInput.h"
+
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+KALEIDOSCOPE_SIMULATOR_INIT
+
+namespace kaleidoscope {
+namespace simulator {
+   
+namespace {
+   
+struct KeyEvents {
+   KeyMatrixBitset press, release, tap;
+   bool read = false;
+};
+
+KeyEvents waitForEvents(RemoteKeyInput &input)
+{
+   KeyEvents events;
+   events.read = input.waitForEvents(100 /* ms */, 
+                                     events.press, 
+                                     events.release, 
+                                     events.tap);
+   return events;
+}
+
+KeyMatrixBitset keys(std::initializer_list<std::pair<uint8_t, uint8_t>> positions)
+{
+   KeyMatrixBitset bitset;
+   for(const auto &position: positions) {
+      bitset.set(SimulatorCore::keyIndex(position.first, position.second));
+   }
+   return bitset;
+}
+
+const uint8_t pressed = RemoteKeyInput::key_pressed;
+const uint8_t released = RemoteKeyInput::key_released;
+const uint8_t tapped = RemoteKeyInput::key_tapped;
+
+} // namespace
+   
+void runSimulator(Simulator &simulator) {
+   
+   std::string path = "/tmp/kaleidoscope_simulator_remote_key_input_" 
+                    + std::to_string(getpid());
+   
+   {
+      auto test = simulator.newTest("Records split across reads from a FIFO");
+      
+      unlink(path.c_str());
+      PAPILIO_ASSERT_CONDITION(simulator, mkfifo(path.c_str(), 0600) == 0);
+      
+      RemoteKeyInput input{path.c_str()};
+      PAPILIO_ASSERT_CONDITION(simulator, input.good());
+      
+      int writer = open(path.c_str(), O_WRONLY);
+      PAPILIO_ASSERT_CONDITION(simulator, writer >= 0);
+      
+      // A complete record followed by the first byte of the next one.
+      //
+      const uint8_t first[] = { pressed, 2, 1, tapped };
+      PAPILIO_ASSERT_CONDITION(simulator, write(writer, first, sizeof(first)) == sizeof(first));
+      
+      auto events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, events.read);
+      PAPILIO_ASSERT_CONDITION(simulator, events.press == keys({{2, 1}}));
+      PAPILIO_ASSERT_CONDITION(simulator, events.release.none());
+      PAPILIO_ASSERT_CONDITION(simulator, events.tap.none());
+      
+      // The incomplete record is not returned.
+      //
+      events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, !events.read);
+      
+      // The remainder of the split record and another record.
+      //
+      const uint8_t second[] = { 0, 6, released, 2, 1 };
+      PAPILIO_ASSERT_CONDITION(simulator, write(writer, second, sizeof(second)) == sizeof(second));
+      
+      events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, events.read);
+      PAPILIO_ASSERT_CONDITION(simulator, events.press.none());
+      PAPILIO_ASSERT_CONDITION(simulator, events.release == keys({{2, 1}}));
+      PAPILIO_ASSERT_CONDITION(simulator, events.tap == keys({{0, 6}}));
+      
+      // An invalid opcode and a key position out of range are skipped.
+      //
+      const uint8_t invalid[] = { 0x07, 0, 0, pressed, 200, 0 };
+      PAPILIO_ASSERT_CONDITION(simulator, write(writer, invalid, sizeof(invalid)) == sizeof(invalid));
+      
+      events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, !events.read);
+      PAPILIO_ASSERT_CONDITION(simulator, input.getNumInvalidRecords() == 2);
+      
+      close(writer);
+      unlink(path.c_str());
+   }
+   
+   {
+      auto test = simulator.newTest("Batches from a regular file");
+      
+      // A regular file is always readable. Each transition of a key
+      // must still be returned in a batch of its own.
+      //
+      const uint8_t records[] = { 
+         pressed, 2, 1, 
+         pressed, 3, 4,
+         released, 2, 1,
+         pressed, 2, 1,
+         released, 3, 4
+      };
+      
+      auto file = std::fopen(path.c_str(), "wb");
+      PAPILIO_ASSERT_CONDITION(simulator, file != nullptr);
+      std::fwrite(records, 1, sizeof(records), file);
+      std::fclose(file);
+      
+      RemoteKeyInput input{path.c_str()};
+      
+      auto events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, events.press == keys({{2, 1}, {3, 4}}));
+      PAPILIO_ASSERT_CONDITION(simulator, events.release.none());
+      
+      // The batch ends before the second transition of key (2, 1). 
+      // Records are never reordered.
+      //
+      events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, events.press.none());
+      PAPILIO_ASSERT_CONDITION(simulator, events.release == keys({{2, 1}}));
+      
+      PAPILIO_ASSERT_CONDITION(simulator, input.good());
+      
+      events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, events.press == keys({{2, 1}}));
+      PAPILIO_ASSERT_CONDITION(simulator, events.release == keys({{3, 4}}));
+      
+      // The end of the file is detected by the next read.
+      //
+      events = waitForEvents(input);
+      PAPILIO_ASSERT_CONDITION(simulator, !events.read);
+      PAPILIO_ASSERT_CONDITION(simulator, !input.good());
+      
+      unlink(path.c_str());
+   }
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
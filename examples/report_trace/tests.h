@@ -0,0 +1,243 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+
+#include "Kaleidoscope-Simulator.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+   
+KALEIDOSCOPE_SIMULATOR_INIT
+
+namespace kaleidoscope {
+namespace simulator {
+   
+namespace {
+   
+// Collects all reports in memory, as a reference for the trace.
+//
+class CollectReports {
+
+   public:
+
+      CollectReports(std::vector<ReportTraceRecord> &records)
+         : CollectReports(DelegateConstruction{}, records)
+      {}
+
+   private:
+
+      class Action : public papilio::ReportAction<papilio::Report_> {
+
+         public:
+
+            Action(std::vector<ReportTraceRecord> &records) : records_(records) {}
+
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Collecting report";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               this->describe(add_indent);
+            }
+
+            virtual bool evalInternal() override {
+
+               const auto &simulator = *this->getSimulator();
+
+               visitReport(this->getReport(), [this, &simulator](const auto &report) {
+                  typedef typename std::decay<decltype(report)>::type ReportType;
+                  ReportTraceRecord record;
+                  record.cycle_id = simulator.getCurrentCycle();
+                  record.time = simulator.getTime();
+                  record.report_id = ReportType::hid_report_type_;
+                  record.data_size = sizeof(report.getReportData());
+                  std::memcpy(record.data, &report.getReportData(), record.data_size);
+                  records_.push_back(record);
+               });
+
+               return true;
+            }
+
+         private:
+
+            std::vector<ReportTraceRecord> &records_;
+      };
+
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(CollectReports)
+};
+
+} // namespace
+   
+void runTraceTest(Simulator &simulator, std::vector<ReportTraceRecord> &expected) {
+   
+   using namespace actions;
+   using namespace papilio::actions;
+   
+   auto test = simulator.newTest("Record and read a report trace");
+   
+   std::string filename = "/tmp/kaleidoscope_simulator_report_trace_"
+                        + std::to_string(getpid()) + ".ksrt";
+   
+   simulator.permanentReportActions().add(RecordReports{filename.c_str()});
+   simulator.permanentReportActions().add(CollectReports{expected});
+   
+   simulator.tapKey(2, 1); // A
+   simulator.cycleExpectReports(AssertKeycodesActive{Key_A});
+   simulator.cycleExpectReports(AssertReportEmpty{});
+   
+   simulator.advanceTimeBy(100);
+   
+   simulator.tapKey(3, 5); // B
+   simulator.cycleExpectReports(AssertKeycodesActive{Key_B});
+   simulator.cycleExpectReports(AssertReportEmpty{});
+   
+   PAPILIO_ASSERT_CONDITION(simulator, expected.size() == 4);
+   
+   // The recording action still exists. Write its buffered records.
+   //
+   ReportTraceWriter::flushAll();
+   
+   ReportTraceReader reader{filename.c_str()};
+   PAPILIO_ASSERT_CONDITION(simulator, reader.good());
+   
+   ReportTraceRecord record;
+   std::size_t n_records = 0;
+   
+   while(reader.read(record)) {
+      
+      if(n_records < expected.size()) {
+         
+         const auto &expected_record = expected[n_records];
+         
+         PAPILIO_ASSERT_CONDITION(simulator, record.cycle_id == expected_record.cycle_id);
+         PAPILIO_ASSERT_CONDITION(simulator, record.time == expected_record.time);
+         PAPILIO_ASSERT_CONDITION(simulator, record.report_id == expected_record.report_id);
+         PAPILIO_ASSERT_CONDITION(simulator, record.data_size == expected_record.data_size);
+         PAPILIO_ASSERT_CONDITION(simulator, 
+            std::memcmp(record.data, expected_record.data, record.data_size) == 0);
+      }
+      
+      ++n_records;
+   }
+   
+   PAPILIO_ASSERT_CONDITION(simulator, reader.good());
+   PAPILIO_ASSERT_CONDITION(simulator, n_records == expected.size());
+   
+   // Check the content of the reports themselves.
+   //
+   if(expected.size() == 4) {
+      PAPILIO_ASSERT_CONDITION(simulator, expected[1].cycle_id == expected[0].cycle_id + 1);
+      PAPILIO_ASSERT_CONDITION(simulator, expected[2].time >= expected[1].time + 100);
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         expected[0].report_id == KeyboardReport::hid_report_type_);
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         KeyboardReport{expected[0].data}.getActiveKeycodes() 
+            == std::vector<uint8_t>{Key_A.getKeyCode()});
+      PAPILIO_ASSERT_CONDITION(simulator, KeyboardReport{expected[1].data}.isEmpty());
+      PAPILIO_ASSERT_CONDITION(simulator, 
+         KeyboardReport{expected[2].data}.getActiveKeycodes() 
+            == std::vector<uint8_t>{Key_B.getKeyCode()});
+   }
+   
+   unlink(filename.c_str());
+}
+
+void runParallelTraceTest(Simulator &simulator) {
+   
+   using namespace actions;
+   using namespace papilio::actions;
+   
+   auto test = simulator.newTest("Record a report trace from parallel tests");
+   
+   std::string filename = "/tmp/kaleidoscope_simulator_report_trace_parallel_"
+                        + std::to_string(getpid()) + ".ksrt";
+   
+   // The buffer only holds a few records. Thus, every worker writes 
+   // to the shared trace file several times and the writes 
+   // of the workers interleave.
+   //
+   simulator.permanentReportActions().add(RecordReports{filename.c_str(), 64});
+   
+   const int n_tests = 8;
+   
+   ParallelTestRunner runner{simulator};
+   
+   for(int i = 0; i < n_tests; ++i) {
+      runner.addTest("Tap A", [&simulator]() {
+         simulator.tapKey(2, 1); // A
+         simulator.cycleExpectReports(AssertKeycodesActive{Key_A});
+         simulator.cycleExpectReports(AssertReportEmpty{});
+      });
+   }
+   
+   PAPILIO_ASSERT_CONDITION(simulator, runner.run(4 /* workers */));
+   
+   ReportTraceWriter::flushAll();
+   
+   // Every record must be complete, no matter which worker wrote it.
+   //
+   ReportTraceReader reader{filename.c_str()};
+   PAPILIO_ASSERT_CONDITION(simulator, reader.good());
+   
+   ReportTraceRecord record;
+   int n_pressed = 0, n_released = 0, n_other = 0;
+   
+   while(reader.read(record)) {
+      
+      if((record.report_id != KeyboardReport::hid_report_type_)
+            || (record.data_size != sizeof(KeyboardReport::ReportDataType))) {
+         ++n_other;
+      }
+      else if(KeyboardReport{record.data}.isEmpty()) {
+         ++n_released;
+      }
+      else if(KeyboardReport{record.data}.getActiveKeycodes() 
+                  == std::vector<uint8_t>{Key_A.getKeyCode()}) {
+         ++n_pressed;
+      }
+      else {
+         ++n_other;
+      }
+   }
+   
+   PAPILIO_ASSERT_CONDITION(simulator, reader.good());
+   PAPILIO_ASSERT_CONDITION(simulator, n_pressed == n_tests);
+   PAPILIO_ASSERT_CONDITION(simulator, n_released == n_tests);
+   PAPILIO_ASSERT_CONDITION(simulator, n_other == 0);
+   
+   unlink(filename.c_str());
+}
+   
+void runSimulator(Simulator &simulator) {
+   
+   // Collected by a permanent action that outlives the test.
+   //
+   std::vector<ReportTraceRecord> expected;
+   
+   runTraceTest(simulator, expected);
+   runParallelTraceTest(simulator);
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
@@ -395,6 +395,18 @@ USE_MAGIC_COMBOS({.action = toggleKeyboardProtocol,
                   .keys = { R3C6, R2C6, R3C7 }
                  });
 
+// Plugins can be profiled in virtual builds (see examples/profiling).
+// The simulator is not available for the actual keyboard. Therefore,
+// the profiling wrappers must only be used in virtual builds.
+#if defined(KALEIDOSCOPE_VIRTUAL_BUILD) && defined(KALEIDOSCOPE_SIMULATOR_PROFILE_PLUGINS)
+#include "kaleidoscope_simulator/profiling/ProfiledPlugin.h"
+KALEIDOSCOPE_SIMULATOR_PROFILED_PLUGIN(LEDControl)
+KALEIDOSCOPE_SIMULATOR_PROFILED_PLUGIN(MouseKeys)
+#define PROFILED(PLUGIN) PLUGIN##_profiled
+#else
+#define PROFILED(PLUGIN) PLUGIN
+#endif
+
 // First, tell Kaleidoscope which plugins you want to use.
 // The order can be important. For example, LED effects are
 // added in the order they're listed here.
@@ -426,7 +438,7 @@ KALEIDOSCOPE_INIT_PLUGINS(
   HardwareTestMode,
 
   // LEDControl provides support for other LED modes
-  LEDControl,
+  PROFILED(LEDControl),
 
   // We start with the LED effect that turns off all the LEDs.
   LEDOff,
@@ -467,7 +479,7 @@ KALEIDOSCOPE_INIT_PLUGINS(
   Macros,
 
   // The MouseKeys plugin lets you add keys to your keymap which move the mouse.
-  MouseKeys,
+  PROFILED(MouseKeys),
 
   // The HostPowerManagement plugin allows us to turn LEDs off when then host
   // goes to sleep, and resume them when it wakes up.
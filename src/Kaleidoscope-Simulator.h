@@ -33,11 +33,22 @@ uint8_t toKeycode(Key key) { return key.getKeyCode(); }
 #include "Papilio.h"
 #include "kaleidoscope_simulator/Simulator.h"
 #include "kaleidoscope_simulator/AglaisInterface.h"
+#include "kaleidoscope_simulator/AglaisBinary.h"
+#include "kaleidoscope_simulator/AsyncLogSink.h"
+#include "kaleidoscope_simulator/HostEventBackend.h"
+#include "kaleidoscope_simulator/ParallelTestRunner.h"
+#include "kaleidoscope_simulator/RemoteKeyInput.h"
+#include "kaleidoscope_simulator/ReportTrace.h"
+#include "kaleidoscope_simulator/profiling/ProfiledPlugin.h"
 #include "papilio/Visualization.h"
+#include "kaleidoscope_simulator/visualization/KeyboardRenderer.h"
+#include "kaleidoscope_simulator/visualization/RenderThread.h"
 
+#include "kaleidoscope_simulator/actions/AssertKeycodeSetActive.h"
 #include "kaleidoscope_simulator/actions/AssertLayerIsActive.h"
 #include "kaleidoscope_simulator/actions/AssertTopActiveLayerIs.h"
 #include "kaleidoscope_simulator/actions/generic_report/GenerateHostEvent.h"
+#include "kaleidoscope_simulator/actions/generic_report/RecordReports.h"
 
 #include <iostream>
 
@@ -63,4 +74,5 @@ extern void executeTestFunction();
       setup(); /* setup Kaleidoscope */                                        \
       using namespace kaleidoscope::simulator;                                 \
       runSimulator(Simulator::getInstance());                                  \
+      profiling::HookProfiler::getInstance().dump(Simulator::getInstance());   \
    }
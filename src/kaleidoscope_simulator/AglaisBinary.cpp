@@ -0,0 +1,401 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/AglaisBinary.h"
+#include "kaleidoscope_simulator/AglaisInterface.h"
+#include "kaleidoscope_simulator/reports/ReportTypes.h"
+
+#include <cstring>
+
+namespace kaleidoscope {
+namespace simulator {
+
+namespace {
+
+const char binary_magic[4] = { 'A', 'G', 'L', 'B' };
+constexpr uint8_t binary_version = 1;
+
+// The text document header (document type and version)
+//
+const char text_header[] = "1 1\n";
+
+// Upper bounds of the lengths stored in records. Lengths are checked
+// before buffers are allocated, so that a corrupt document cannot
+// trigger huge allocations.
+//
+constexpr uint32_t max_firmware_id_length = 4096;
+constexpr uint32_t max_report_length = 64;
+constexpr uint32_t max_cycles_per_record = 1 << 24;
+
+// Checks if a HID report record can be passed to a consumer. Reports of
+// registered types must have the size of their report data. Consumers 
+// read that many bytes. Reports of ignored types are not read.
+//
+bool isValidHIDReport(uint8_t id, uint32_t length)
+{
+   if(isIgnoredHIDReportType(id)) { return true; }
+   
+   auto size = getReportDataSize(id);
+   return (size != 0) && (length == size);
+}
+
+enum Tag : uint8_t {
+   tag_firmware_id  = 0x01,
+   tag_start_cycle  = 0x02,
+   tag_end_cycle    = 0x03,
+   tag_key_pressed  = 0x04,
+   tag_key_released = 0x05,
+   tag_hid_report   = 0x06,
+   tag_set_time     = 0x07,
+   tag_cycles       = 0x08
+};
+
+// Reads directly from the stream buffer, which avoids the overhead of
+// formatted and sentry-guarded stream input.
+//
+class BinaryReader
+{
+   public:
+
+      BinaryReader(std::istream &in) : buffer_(in.rdbuf()) {}
+
+      bool atEnd() {
+         return buffer_->sgetc() == std::char_traits<char>::eof();
+      }
+
+      bool readByte(uint8_t &byte) {
+         auto c = buffer_->sbumpc();
+         if(c == std::char_traits<char>::eof()) { return false; }
+         byte = static_cast<uint8_t>(c);
+         return true;
+      }
+
+      bool readBytes(void *target, std::size_t n) {
+         return buffer_->sgetn(static_cast<char*>(target), n)
+                     == static_cast<std::streamsize>(n);
+      }
+
+      bool readVarint(uint32_t &value) {
+         value = 0;
+         for(int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte;
+            if(!this->readByte(byte)) { return false; }
+            
+            // The fifth byte holds the upper four bits of a 32 bit value
+            // and ends the varint.
+            //
+            if((shift == 28) && (byte & 0xF0)) { return false; }
+            
+            value |= uint32_t(byte & 0x7F) << shift;
+            if(!(byte & 0x80)) { return true; }
+         }
+         return false;
+      }
+
+   private:
+
+      std::streambuf *buffer_;
+};
+
+} // namespace
+
+   AglaisBinaryEncoder::AglaisBinaryEncoder(std::ostream &out)
+   :  out_(out)
+{
+   out_.write(binary_magic, sizeof(binary_magic));
+   this->writeByte(binary_version);
+}
+
+void AglaisBinaryEncoder::writeVarint(uint32_t value)
+{
+   while(value >= 0x80) {
+      this->writeByte(static_cast<uint8_t>(value) | 0x80);
+      value >>= 7;
+   }
+   this->writeByte(static_cast<uint8_t>(value));
+}
+
+void AglaisBinaryEncoder::onFirmwareId(const char *firmware_id)
+{
+   uint32_t length = std::strlen(firmware_id);
+   this->writeByte(tag_firmware_id);
+   this->writeVarint(length);
+   out_.write(firmware_id, length);
+}
+
+void AglaisBinaryEncoder::onStartCycle(uint32_t cycle_id, uint32_t cycle_start_time)
+{
+   this->writeByte(tag_start_cycle);
+   this->writeVarint(cycle_id);
+   this->writeVarint(cycle_start_time);
+}
+
+void AglaisBinaryEncoder::onEndCycle(uint32_t cycle_id, uint32_t cycle_end_time)
+{
+   this->writeByte(tag_end_cycle);
+   this->writeVarint(cycle_id);
+   this->writeVarint(cycle_end_time);
+}
+
+void AglaisBinaryEncoder::onKeyPressed(uint8_t row, uint8_t col)
+{
+   this->writeByte(tag_key_pressed);
+   this->writeByte(row);
+   this->writeByte(col);
+}
+
+void AglaisBinaryEncoder::onKeyReleased(uint8_t row, uint8_t col)
+{
+   this->writeByte(tag_key_released);
+   this->writeByte(row);
+   this->writeByte(col);
+}
+
+void AglaisBinaryEncoder::onHIDReport(uint8_t id, int length, const uint8_t *data)
+{
+   this->writeByte(tag_hid_report);
+   this->writeByte(id);
+   this->writeVarint(length);
+   out_.write(reinterpret_cast<const char*>(data), length);
+}
+
+void AglaisBinaryEncoder::onSetTime(uint32_t time)
+{
+   this->writeByte(tag_set_time);
+   this->writeVarint(time);
+}
+
+void AglaisBinaryEncoder::onCycles(uint32_t start_cycle_id, uint32_t start_time_id,
+                                   const std::vector<uint32_t> &cycle_durations)
+{
+   this->writeByte(tag_cycles);
+   this->writeVarint(start_cycle_id);
+   this->writeVarint(start_time_id);
+   this->writeVarint(cycle_durations.size());
+   for(auto duration: cycle_durations) {
+      this->writeVarint(duration);
+   }
+}
+
+   AglaisTextEncoder::AglaisTextEncoder(std::ostream &out)
+   :  out_(out)
+{
+   out_ << text_header;
+}
+
+void AglaisTextEncoder::onFirmwareId(const char *firmware_id)
+{
+   out_ << "firmware_id \"" << firmware_id << "\"\n";
+}
+
+void AglaisTextEncoder::onStartCycle(uint32_t cycle_id, uint32_t cycle_start_time)
+{
+   out_ << "start_cycle " << cycle_id << ' ' << cycle_start_time << '\n';
+}
+
+void AglaisTextEncoder::onEndCycle(uint32_t cycle_id, uint32_t cycle_end_time)
+{
+   out_ << "end_cycle " << cycle_id << ' ' << cycle_end_time << '\n';
+}
+
+void AglaisTextEncoder::onKeyPressed(uint8_t row, uint8_t col)
+{
+   out_ << "action key_pressed " << int(row) << ' ' << int(col) << '\n';
+}
+
+void AglaisTextEncoder::onKeyReleased(uint8_t row, uint8_t col)
+{
+   out_ << "action key_released " << int(row) << ' ' << int(col) << '\n';
+}
+
+void AglaisTextEncoder::onHIDReport(uint8_t id, int length, const uint8_t *data)
+{
+   out_ << "reaction hid_report " << int(id) << ' ' << length << ' ';
+   for(int i = 0; i < length; ++i) {
+      out_ << int(data[i]) << ' ';
+   }
+   out_ << '\n';
+}
+
+void AglaisTextEncoder::onSetTime(uint32_t time)
+{
+   out_ << "set_time " << time << '\n';
+}
+
+void AglaisTextEncoder::onCycles(uint32_t start_cycle_id, uint32_t start_time_id,
+                                 const std::vector<uint32_t> &cycle_durations)
+{
+   out_ << "cycles " << start_cycle_id << ' ' << start_time_id << ' '
+        << cycle_durations.size() << ' ';
+   for(auto duration: cycle_durations) {
+      out_ << duration << ' ';
+   }
+   out_ << '\n';
+}
+
+bool decodeAglaisBinary(std::istream &in, aglais::Consumer_ &consumer,
+                        std::string *error_message)
+{
+   auto fail = [error_message](const char *message) {
+      if(error_message) { *error_message = message; }
+      return false;
+   };
+
+   BinaryReader reader(in);
+
+   char magic[sizeof(binary_magic)];
+   uint8_t version;
+   if(!reader.readBytes(magic, sizeof(magic))
+         || (std::memcmp(magic, binary_magic, sizeof(magic)) != 0)
+         || !reader.readByte(version)) {
+      return fail("Not a binary Aglais document");
+   }
+
+   if(version != binary_version) {
+      return fail("Unsupported binary Aglais version");
+   }
+
+   // Buffers are reused for all records.
+   //
+   std::string firmware_id;
+   std::vector<uint8_t> report_data;
+   std::vector<uint32_t> cycle_durations;
+
+   while(!reader.atEnd()) {
+
+      uint8_t tag;
+      reader.readByte(tag);
+
+      bool complete = false;
+
+      switch(tag) {
+         case tag_firmware_id:
+            {
+               uint32_t length;
+               if(reader.readVarint(length) 
+                     && (length <= max_firmware_id_length)) {
+                  firmware_id.resize(length);
+                  complete = reader.readBytes(&firmware_id[0], length);
+                  if(complete) { consumer.onFirmwareId(firmware_id.c_str()); }
+               }
+            }
+            break;
+         case tag_start_cycle:
+         case tag_end_cycle:
+            {
+               uint32_t cycle_id, time;
+               complete = reader.readVarint(cycle_id) && reader.readVarint(time);
+               if(complete) {
+                  if(tag == tag_start_cycle) {
+                     consumer.onStartCycle(cycle_id, time);
+                  }
+                  else {
+                     consumer.onEndCycle(cycle_id, time);
+                  }
+               }
+            }
+            break;
+         case tag_key_pressed:
+         case tag_key_released:
+            {
+               uint8_t row, col;
+               complete = reader.readByte(row) && reader.readByte(col);
+               if(complete) {
+                  if(tag == tag_key_pressed) {
+                     consumer.onKeyPressed(row, col);
+                  }
+                  else {
+                     consumer.onKeyReleased(row, col);
+                  }
+               }
+            }
+            break;
+         case tag_hid_report:
+            {
+               uint8_t id;
+               uint32_t length;
+               if(reader.readByte(id) && reader.readVarint(length)
+                     && (length <= max_report_length)) {
+                  if(!isValidHIDReport(id, length)) {
+                     return fail("Invalid HID report in binary Aglais document");
+                  }
+                  report_data.resize(length);
+                  complete = reader.readBytes(report_data.data(), length);
+                  if(complete) {
+                     consumer.onHIDReport(id, length, report_data.data());
+                  }
+               }
+            }
+            break;
+         case tag_set_time:
+            {
+               uint32_t time;
+               complete = reader.readVarint(time);
+               if(complete) { consumer.onSetTime(time); }
+            }
+            break;
+         case tag_cycles:
+            {
+               uint32_t start_cycle_id, start_time, n;
+               if(reader.readVarint(start_cycle_id)
+                     && reader.readVarint(start_time)
+                     && reader.readVarint(n)
+                     && (n <= max_cycles_per_record)) {
+                  
+                  // The buffer grows with the durations actually read.
+                  //
+                  cycle_durations.clear();
+                  complete = true;
+                  for(uint32_t i = 0; complete && (i < n); ++i) {
+                     uint32_t duration;
+                     complete = reader.readVarint(duration);
+                     cycle_durations.push_back(duration);
+                  }
+                  if(complete) {
+                     consumer.onCycles(start_cycle_id, start_time, cycle_durations);
+                  }
+               }
+            }
+            break;
+         default:
+            return fail("Unknown record tag in binary Aglais document");
+      }
+
+      if(!complete) {
+         return fail("Truncated binary Aglais document");
+      }
+   }
+
+   return true;
+}
+
+void convertAglaisTextToBinary(std::istream &text, std::ostream &binary)
+{
+   AglaisBinaryEncoder encoder(binary);
+   parseAglaisDocument(text, encoder);
+}
+
+bool convertAglaisBinaryToText(std::istream &binary, std::ostream &text,
+                               std::string *error_message)
+{
+   AglaisTextEncoder encoder(text);
+   return decodeAglaisBinary(binary, encoder, error_message);
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
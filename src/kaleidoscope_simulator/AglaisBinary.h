@@ -0,0 +1,144 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "aglais/Consumer_.h"
+
+#include <istream>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace kaleidoscope {
+namespace simulator {
+
+// The binary Aglais format encodes the same event stream as the text
+// format. A document starts with the magic string "AGLB" and a version
+// byte. It is followed by records, each consisting of a tag byte and
+// the record's fields. Integers are stored as unsigned LEB128 varints.
+//
+//    tag                 fields
+//    -----------------   ------------------------------------------------
+//    firmware_id   0x01  length, characters
+//    start_cycle   0x02  cycle id, time
+//    end_cycle     0x03  cycle id, time
+//    key_pressed   0x04  row byte, column byte
+//    key_released  0x05  row byte, column byte
+//    hid_report    0x06  report id byte, length, report bytes
+//    set_time      0x07  time
+//    cycles        0x08  start cycle id, start time, n, n cycle durations
+//
+// Firmware ids are limited to 4096 characters, HID reports to 64 bytes
+// and cycles records to 2^24 cycle durations.
+
+/// @brief An Aglais consumer that writes the events it receives
+///        as binary Aglais document.
+/// @details Pass it to the Aglais parser or to parseAglaisDocument(...)
+///        to convert a text document to binary.
+///
+class AglaisBinaryEncoder : public aglais::Consumer_
+{
+   public:
+
+      /// @brief Constructor. Writes the document header.
+      /// @param out The output stream. Must be opened in binary mode.
+      ///
+      AglaisBinaryEncoder(std::ostream &out);
+
+      virtual void onFirmwareId(const char *firmware_id) override;
+      virtual void onStartCycle(uint32_t cycle_id, uint32_t cycle_start_time) override;
+      virtual void onEndCycle(uint32_t cycle_id, uint32_t cycle_end_time) override;
+      virtual void onKeyPressed(uint8_t row, uint8_t col) override;
+      virtual void onKeyReleased(uint8_t row, uint8_t col) override;
+      virtual void onHIDReport(uint8_t id, int length, const uint8_t *data) override;
+      virtual void onSetTime(uint32_t time) override;
+      virtual void onCycles(uint32_t start_cycle_id, uint32_t start_time_id,
+                            const std::vector<uint32_t> &cycle_durations) override;
+
+   private:
+
+      void writeByte(uint8_t byte) { out_.put(static_cast<char>(byte)); }
+      void writeVarint(uint32_t value);
+
+   private:
+
+      std::ostream &out_;
+};
+
+/// @brief An Aglais consumer that writes the events it receives
+///        as text Aglais document.
+///
+class AglaisTextEncoder : public aglais::Consumer_
+{
+   public:
+
+      /// @brief Constructor. Writes the document header.
+      /// @param out The output stream.
+      ///
+      AglaisTextEncoder(std::ostream &out);
+
+      virtual void onFirmwareId(const char *firmware_id) override;
+      virtual void onStartCycle(uint32_t cycle_id, uint32_t cycle_start_time) override;
+      virtual void onEndCycle(uint32_t cycle_id, uint32_t cycle_end_time) override;
+      virtual void onKeyPressed(uint8_t row, uint8_t col) override;
+      virtual void onKeyReleased(uint8_t row, uint8_t col) override;
+      virtual void onHIDReport(uint8_t id, int length, const uint8_t *data) override;
+      virtual void onSetTime(uint32_t time) override;
+      virtual void onCycles(uint32_t start_cycle_id, uint32_t start_time_id,
+                            const std::vector<uint32_t> &cycle_durations) override;
+
+   private:
+
+      std::ostream &out_;
+};
+
+/// @brief Decodes a binary Aglais document and passes its events
+///        to an Aglais consumer.
+/// @details HID reports are only passed to the consumer if their 
+///        report type is registered (see ReportTypes.h) and their length
+///        matches the type's report data, or if their type is ignored by 
+///        the simulator. Any other HID report renders the document invalid.
+/// @param in The input stream. Must be opened in binary mode.
+/// @param consumer The consumer.
+/// @param error_message If non-null, receives a description of the
+///        problem if decoding fails.
+/// @returns True if the whole document was decoded.
+///
+bool decodeAglaisBinary(std::istream &in, aglais::Consumer_ &consumer,
+                        std::string *error_message = nullptr);
+
+/// @brief Converts a text Aglais document to a binary one.
+/// @param text The text input stream.
+/// @param binary The binary output stream.
+///
+void convertAglaisTextToBinary(std::istream &text, std::ostream &binary);
+
+/// @brief Converts a binary Aglais document to a text one.
+/// @param binary The binary input stream.
+/// @param text The text output stream.
+/// @param error_message If non-null, receives a description of the
+///        problem if decoding fails.
+/// @returns True if the whole document was converted.
+///
+bool convertAglaisBinaryToText(std::istream &binary, std::ostream &text,
+                               std::string *error_message = nullptr);
+
+} // namespace simulator
+} // namespace kaleidoscope
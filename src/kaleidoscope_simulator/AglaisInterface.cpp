@@ -16,16 +16,28 @@
  */
 
 #include "kaleidoscope_simulator/AglaisInterface.h"
-#include "kaleidoscope_simulator/reports/KeyboardReport.h"
-#include "kaleidoscope_simulator/reports/BootKeyboardReport.h"
-#include "kaleidoscope_simulator/reports/MouseReport.h"
-#include "kaleidoscope_simulator/reports/AbsoluteMouseReport.h"
+#include "kaleidoscope_simulator/AglaisBinary.h"
+#include "kaleidoscope_simulator/Simulator.h"
+#include "kaleidoscope_simulator/reports/ReportTypes.h"
+#include "kaleidoscope_simulator/aux/logging.h"
 #include "Aglais.h"
 #include "aglais/Consumer_.h"
 #include "papilio/actions/generic_report/AssertReportEquals.h"
 #include "papilio/Simulator.h"
 #include "HID-Settings.h"
 
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KS_T_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace kaleidoscope {
 namespace simulator {
    
@@ -35,23 +47,37 @@ class SimulatorConsumerAdaptor : public aglais::Consumer_
 {
    public:
       
-      SimulatorConsumerAdaptor(papilio::Simulator &simulator)
-         :  simulator_(simulator)
-      {}
+      SimulatorConsumerAdaptor(papilio::Simulator &simulator,
+                               AglaisReplay replay = AglaisReplay::verify_reports)
+         :  simulator_(simulator),
+            fast_forward_simulator_(dynamic_cast<Simulator*>(&simulator)),
+            replay_(replay)
+      {
+         if(fast_forward_simulator_ 
+               && !fast_forward_simulator_->getIdleFastForward()) {
+            fast_forward_simulator_ = nullptr;
+         }
+      }
       
       virtual void onFirmwareId(const char *firmware_id) override {
-         simulator_.log() << "Aglais: firmware_id " << firmware_id;
+         
+         // Streamed documents repeat their header with every chunk.
+         //
+         if(firmware_id_reported_) { return; }
+         firmware_id_reported_ = true;
+         
+         KS_LOG(simulator_, INFO, "Aglais: firmware_id " << firmware_id);
          // TODO: Use this method to verify that the firmware that was used
          //       to generate the Aglais-script that is currently 
          //       parsed matches the firmware running in the simulator.
       }
       
       virtual void onStartCycle(uint32_t cycle_id, uint32_t cycle_start_time) override {
-         //simulator_.log() << "Aglais: start_cycle " << cycle_id << ' ' << cycle_start_time;
-         simulator_.setTime(cycle_start_time);
+         KS_LOG(simulator_, TRACE, "Aglais: start_cycle " << cycle_id << ' ' << cycle_start_time);
+         simulator_.setTime(this->simulatorTime(cycle_start_time));
       }
       virtual void onEndCycle(uint32_t cycle_id, uint32_t cycle_end_time) override {
-         //simulator_.log() << "Aglais: end_cycle " << cycle_id << ' ' << cycle_end_time; 
+         KS_LOG(simulator_, TRACE, "Aglais: end_cycle " << cycle_id << ' ' << cycle_end_time);
          
          simulator_.cycle(true /*suppress cycle log info*/);
          
@@ -59,18 +85,18 @@ class SimulatorConsumerAdaptor : public aglais::Consumer_
             simulator_.error() << "Report actions are left in queue";
          }
          
-         simulator_.setTime(cycle_end_time);
+         simulator_.setTime(this->simulatorTime(cycle_end_time));
       }
       virtual void onKeyPressed(uint8_t row, uint8_t col) override {
-         simulator_.log() << "Aglais: action key_pressed " << (int)row << ' ' << (int)col;
+         KS_LOG(simulator_, DEBUG, "Aglais: action key_pressed " << (int)row << ' ' << (int)col);
          simulator_.pressKey(row, col);
       }
       virtual void onKeyReleased(uint8_t row, uint8_t col) override {
-         simulator_.log() << "Aglais: action key_released " << (int)row << ' ' << (int)col;
+         KS_LOG(simulator_, DEBUG, "Aglais: action key_released " << (int)row << ' ' << (int)col);
          simulator_.releaseKey(row, col);
       }
       virtual void onHIDReport(uint8_t id, int length, const uint8_t *data) override {
-         {
+         if(KS_LOG_ENABLED(simulator_, DEBUG)) {
             auto log = simulator_.log();
             
             log << "Aglais: reaction hid_report " << (int)id << ' ' << (int)length << ' ';
@@ -79,53 +105,38 @@ class SimulatorConsumerAdaptor : public aglais::Consumer_
             }
          }
             
-         switch(id) {
-            // TODO: React appropriately on the following
+         if(replay_ == AglaisReplay::input_only) { return; }
+            
+         // TODO: React appropriately on ignored report types
+         //
+         if(isIgnoredHIDReportType(id)) {
+            KS_LOG(simulator_, INFO, "***Ignoring hid report with id = " << id);
+            return;
+         }
+         
+         bool known = visitReportType(id, [this, id, length, data](auto tag) {
+            typedef typename decltype(tag)::Type ReportType;
+            
+            // The report is constructed from the recorded data. Reports 
+            // of corrupt documents must not be read past their end.
             //
-            case HID_REPORTID_GAMEPAD:
-            case HID_REPORTID_CONSUMERCONTROL:
-            case HID_REPORTID_SYSTEMCONTROL:
-               simulator_.log() << "***Ignoring hid report with id = " << id;
-               break;
-            case HID_REPORTID_KEYBOARD:
-               {
-                  assert(length == sizeof(BootKeyboardReport::ReportDataType));
-                  simulator_.reportActionsQueue().queue(
-                     papilio::actions::AssertReportEquals<BootKeyboardReport>{data}
-                  );
-               }
-               break;
-            case HID_REPORTID_MOUSE_ABSOLUTE:
-               {
-                  assert(length == sizeof(AbsoluteMouseReport::ReportDataType));
-                  simulator_.reportActionsQueue().queue(
-                     papilio::actions::AssertReportEquals<AbsoluteMouseReport>{data}
-                  );
-               }
-               break;
-            case HID_REPORTID_MOUSE:
-               {
-                  assert(length == sizeof(MouseReport::ReportDataType));
-                  simulator_.reportActionsQueue().queue(
-                     papilio::actions::AssertReportEquals<MouseReport>{data}
-                  );
-               }
-               break;
-            case HID_REPORTID_NKRO_KEYBOARD:
-               {
-                  assert(length == sizeof(KeyboardReport::ReportDataType));
-                  simulator_.reportActionsQueue().queue(
-                     papilio::actions::AssertReportEquals<KeyboardReport>{data}
-                  );
-               }
-               break;
-            default:
-               simulator_.error() << "Aglais encountered unknown HID report with id = " << id;
+            if(length != sizeof(typename ReportType::ReportDataType)) {
+               simulator_.error() << "Aglais encountered hid report with id = " 
+                  << (int)id << " and invalid length " << length;
+               return;
+            }
+            simulator_.reportActionsQueue().queue(
+               papilio::actions::AssertReportEquals<ReportType>{data}
+            );
+         });
+         
+         if(!known) {
+            simulator_.error() << "Aglais encountered unknown HID report with id = " << id;
          }
       }
       virtual void onSetTime(uint32_t time) override {
-         simulator_.log() << "Aglais: set_time " << time;
-         simulator_.setTime(time);
+         KS_LOG(simulator_, DEBUG, "Aglais: set_time " << time);
+         simulator_.setTime(this->simulatorTime(time));
       }
       virtual void onCycle(uint32_t cycle_id, uint32_t cycle_start_time, uint32_t cycle_end_time) {
          this->onStartCycle(cycle_id, cycle_start_time);
@@ -135,32 +146,290 @@ class SimulatorConsumerAdaptor : public aglais::Consumer_
                                const std::vector<uint32_t> &cycle_durations) override {
          auto cycle_start_time = start_time_id;
          auto cycle_id = start_cycle_id;
-         for(const auto duration: cycle_durations) {
+         std::size_t i = 0;
+         while(i < cycle_durations.size()) {
+            auto duration = cycle_durations[i];
+            ++i;
+            
+            // While the firmware is idle, merge consecutive recorded
+            // cycles into a single one.
+            //
+            if(fast_forward_simulator_ && fast_forward_simulator_->isIdle()) {
+               auto max_time_step = fast_forward_simulator_->getIdleFastForwardTimeStep();
+               while((i < cycle_durations.size())
+                     && (duration + cycle_durations[i] <= max_time_step)) {
+                  duration += cycle_durations[i];
+                  ++i;
+               }
+            }
+            
             auto cycle_end_time = cycle_start_time + duration;
             this->onCycle(cycle_id, cycle_start_time, cycle_end_time);
-            ++cycle_id;
+            cycle_id = start_cycle_id + i;
             cycle_start_time = cycle_end_time;
          }
       }
       
+   private:
+      
+      // Maps a recorded time to simulator time. When replaying input only,
+      // the first recorded time is mapped to the simulator's current time.
+      //
+      uint32_t simulatorTime(uint32_t recorded_time) {
+         
+         if(replay_ != AglaisReplay::input_only) { return recorded_time; }
+         
+         if(!time_offset_valid_) {
+            time_offset_ = simulator_.getTime() - recorded_time;
+            time_offset_valid_ = true;
+         }
+         
+         return recorded_time + time_offset_;
+      }
+      
    private:
       
       papilio::Simulator &simulator_;
+      Simulator *fast_forward_simulator_;
+      AglaisReplay replay_;
+      bool firmware_id_reported_ = false;
+      uint32_t time_offset_ = 0;
+      bool time_offset_valid_ = false;
+};
+
+/// @private
+/// @brief Splits an Aglais document into chunks of lines and 
+///        parses them one by one.
+///
+class AglaisDocumentChunker
+{
+   public:
+      
+      AglaisDocumentChunker(aglais::Consumer_ &consumer, std::size_t chunk_size)
+         :  consumer_(consumer),
+            chunk_size_(chunk_size)
+      {
+         chunk_.reserve(chunk_size_ + 4096);
+      }
+      
+      void addLine(const char *line, std::size_t length) {
+         
+         bool cycle_start = isCycleStart(line, length);
+         
+         if(in_header_) {
+            if(!cycle_start) {
+               chunk_.append(line, length);
+               chunk_.push_back('\n');
+               return;
+            }
+            in_header_ = false;
+            header_size_ = chunk_.size();
+         }
+         
+         // Chunks only end at cycle boundaries.
+         //
+         if(cycle_start && (chunk_.size() - header_size_ >= chunk_size_)) {
+            this->parseChunk();
+         }
+         
+         chunk_.append(line, length);
+         chunk_.push_back('\n');
+      }
+      
+      void finish() {
+         if(in_header_ || (chunk_.size() > header_size_)) {
+            this->parseChunk();
+         }
+      }
+      
+   private:
+      
+      static bool isCycleStart(const char *line, std::size_t length) {
+         return startsWith(line, length, "start_cycle ")
+             || startsWith(line, length, "cycles ");
+      }
+      
+      static bool startsWith(const char *line, std::size_t length, const char *prefix) {
+         std::size_t prefix_length = std::strlen(prefix);
+         return (length >= prefix_length) 
+             && (std::memcmp(line, prefix, prefix_length) == 0);
+      }
+      
+      void parseChunk() {
+         aglais_.parse(chunk_.c_str(), consumer_);
+         
+         // Keep the header for the next chunk.
+         //
+         chunk_.resize(header_size_);
+      }
+      
+   private:
       
+      aglais::Aglais aglais_;
+      aglais::Consumer_ &consumer_;
+      std::size_t chunk_size_;
+      
+      std::string chunk_;
+      std::size_t header_size_ = 0;
+      bool in_header_ = true;
 };
 
-void processAglaisDocument(const char *code, papilio::Simulator &simulator)
+void processAglaisDocument(const char *code, papilio::Simulator &simulator,
+                           AglaisReplay replay)
 {
    auto rwqa_state = simulator.getErrorIfReportWithoutQueuedActions();
    
+   if(replay == AglaisReplay::input_only) {
+      simulator.setErrorIfReportWithoutQueuedActions(false);
+   }
+   
    aglais::Aglais a;
    //a.setDebug(true);
    
-   SimulatorConsumerAdaptor sca(simulator);
+   SimulatorConsumerAdaptor sca(simulator, replay);
    a.parse(code, sca);
    
    simulator.setErrorIfReportWithoutQueuedActions(rwqa_state);
 }
 
+void parseAglaisDocument(std::istream &in, aglais::Consumer_ &consumer,
+                         std::size_t chunk_size)
+{
+   AglaisDocumentChunker chunker(consumer, chunk_size);
+   
+   std::string line;
+   while(std::getline(in, line)) {
+      chunker.addLine(line.data(), line.size());
+   }
+   
+   chunker.finish();
+}
+
+void processAglaisDocument(std::istream &in, papilio::Simulator &simulator,
+                           std::size_t chunk_size)
+{
+   auto rwqa_state = simulator.getErrorIfReportWithoutQueuedActions();
+   
+   SimulatorConsumerAdaptor sca(simulator);
+   parseAglaisDocument(in, sca, chunk_size);
+   
+   simulator.setErrorIfReportWithoutQueuedActions(rwqa_state);
+}
+
+#ifdef KS_T_HAVE_MMAP
+
+namespace {
+   
+bool processMappedAglaisFile(const char *filename, papilio::Simulator &simulator,
+                             std::size_t chunk_size)
+{
+   int fd = open(filename, O_RDONLY);
+   if(fd < 0) {
+      simulator.error() << "Unable to open Aglais file " << filename;
+      return false;
+   }
+   
+   struct stat file_stat;
+   if(fstat(fd, &file_stat) != 0) {
+      simulator.error() << "Unable to stat Aglais file " << filename;
+      close(fd);
+      return false;
+   }
+   
+   std::size_t size = file_stat.st_size;
+   
+   SimulatorConsumerAdaptor sca(simulator);
+   AglaisDocumentChunker chunker(sca, chunk_size);
+   
+   if(size > 0) {
+      void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      
+      if(mapped == MAP_FAILED) {
+         simulator.error() << "Unable to memory map Aglais file " << filename;
+         close(fd);
+         return false;
+      }
+      
+      madvise(mapped, size, MADV_SEQUENTIAL);
+      
+      const char *pos = static_cast<const char*>(mapped);
+      const char *end = pos + size;
+      
+      while(pos < end) {
+         const char *eol = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+         if(!eol) { eol = end; }
+         chunker.addLine(pos, eol - pos);
+         pos = eol + 1;
+      }
+      
+      munmap(mapped, size);
+   }
+   
+   close(fd);
+   
+   chunker.finish();
+   
+   return true;
+}
+
+} // namespace
+
+#endif
+
+bool processAglaisFile(const char *filename, papilio::Simulator &simulator,
+                       bool memory_map, std::size_t chunk_size)
+{
+#ifdef KS_T_HAVE_MMAP
+   if(memory_map) {
+      auto rwqa_state = simulator.getErrorIfReportWithoutQueuedActions();
+      
+      bool success = processMappedAglaisFile(filename, simulator, chunk_size);
+      
+      simulator.setErrorIfReportWithoutQueuedActions(rwqa_state);
+      
+      return success;
+   }
+#endif
+
+   // The file is streamed if memory mapping is disabled or not supported.
+   //
+   std::ifstream in(filename);
+   if(!in) {
+      simulator.error() << "Unable to open Aglais file " << filename;
+      return false;
+   }
+   processAglaisDocument(in, simulator, chunk_size);
+   return true;
+}
+
+bool processAglaisBinaryDocument(std::istream &in, papilio::Simulator &simulator)
+{
+   auto rwqa_state = simulator.getErrorIfReportWithoutQueuedActions();
+   
+   SimulatorConsumerAdaptor sca(simulator);
+   
+   std::string error_message;
+   bool success = decodeAglaisBinary(in, sca, &error_message);
+   
+   if(!success) {
+      simulator.error() << error_message;
+   }
+   
+   simulator.setErrorIfReportWithoutQueuedActions(rwqa_state);
+   
+   return success;
+}
+
+bool processAglaisBinaryFile(const char *filename, papilio::Simulator &simulator)
+{
+   std::ifstream in(filename, std::ios::binary);
+   if(!in) {
+      simulator.error() << "Unable to open binary Aglais file " << filename;
+      return false;
+   }
+   
+   return processAglaisBinaryDocument(in, simulator);
+}
+
 } // namespace simulator
 } // namespace kaleidoscope
@@ -17,14 +17,107 @@
 
 #pragma once
 
+#include <cstddef>
+#include <istream>
+
 namespace papilio {
 class Simulator;
 } // namespace papilio
 
+namespace aglais {
+class Consumer_;
+} // namespace aglais
+
 namespace kaleidoscope {
 namespace simulator {
 
-void processAglaisDocument(const char *code, papilio::Simulator &sim);
+/// @brief The ways to replay an Aglais document.
+///
+enum class AglaisReplay {
+   
+   /// @brief Replays the recorded input at the recorded times and asserts
+   ///        that the recorded HID reports are generated.
+   ///
+   verify_reports,
+   
+   /// @brief Replays the recorded input only. Recorded HID reports
+   ///        are ignored. Recorded times are shifted, so that the document
+   ///        starts at the simulator's current time. Thus, a document can
+   ///        be replayed repeatedly, e.g. for benchmarking, without time
+   ///        moving backwards.
+   ///
+   input_only
+};
+
+/// @brief Processes an Aglais document that is stored in a string.
+/// @param code The Aglais document.
+/// @param sim The simulator.
+/// @param replay How to replay the document.
+///
+void processAglaisDocument(const char *code, papilio::Simulator &sim,
+                           AglaisReplay replay = AglaisReplay::verify_reports);
+
+/// @brief The default number of bytes that are read from Aglais documents
+///        in one chunk when streaming.
+///
+constexpr std::size_t aglais_default_chunk_size = 1 << 20;
+
+/// @brief Processes an Aglais document that is read from a stream,
+///        e.g. std::cin.
+/// @details The document is read line by line and passed to the Aglais
+///        parser in chunks that end at cycle boundaries. The document header
+///        (all lines before the first cycle) is prepended to every chunk.
+///        Memory consumption is bounded by the chunk size, independent
+///        of the document's length.
+/// @param in The input stream.
+/// @param sim The simulator.
+/// @param chunk_size The approximate number of bytes per chunk.
+///
+void processAglaisDocument(std::istream &in, papilio::Simulator &sim,
+                           std::size_t chunk_size = aglais_default_chunk_size);
+
+/// @brief Parses an Aglais document that is read from a stream and
+///        passes its content to an arbitrary Aglais consumer.
+/// @details The document is streamed in chunks, see 
+///        processAglaisDocument(std::istream &, ...).
+/// @param in The input stream.
+/// @param consumer The consumer.
+/// @param chunk_size The approximate number of bytes per chunk.
+///
+void parseAglaisDocument(std::istream &in, aglais::Consumer_ &consumer,
+                         std::size_t chunk_size = aglais_default_chunk_size);
+
+/// @brief Processes an Aglais document that is read from a file.
+/// @details The document is streamed (see processAglaisDocument(std::istream &, ...)).
+///        With memory mapping enabled, the file is mapped instead of read.
+///        This avoids copying the file through a stream buffer.
+///        On platforms without memory mapping, the file is always streamed.
+/// @param filename The name of the Aglais file.
+/// @param sim The simulator.
+/// @param memory_map Whether to memory map the file.
+/// @param chunk_size The approximate number of bytes per chunk.
+/// @returns False if the file could not be opened or mapped.
+///
+bool processAglaisFile(const char *filename, papilio::Simulator &sim,
+                       bool memory_map = false,
+                       std::size_t chunk_size = aglais_default_chunk_size);
+
+/// @brief Processes a binary Aglais document (see AglaisBinary.h)
+///        that is read from a stream.
+/// @param in The input stream. Must be opened in binary mode.
+/// @param sim The simulator.
+/// @returns False if the document is not a valid binary Aglais document.
+///
+bool processAglaisBinaryDocument(std::istream &in, papilio::Simulator &sim);
+
+/// @brief Processes a binary Aglais document (see AglaisBinary.h)
+///        that is read from a file.
+/// @param filename The name of the binary Aglais file.
+/// @param sim The simulator.
+/// @returns False if the file could not be opened or is not a valid
+///        binary Aglais document.
+///
+bool processAglaisBinaryFile(const char *filename, papilio::Simulator &sim);
 
 } // namespace simulator
 } // namespace kaleidoscope
@@ -0,0 +1,178 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/AsyncLogSink.h"
+#include "kaleidoscope_simulator/aux/BackgroundThreads.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace kaleidoscope {
+namespace simulator {
+
+namespace {
+
+size_t roundUpToPowerOfTwo(size_t n)
+{
+   size_t result = 1;
+   while(result < n) { result <<= 1; }
+   return result;
+}
+
+} // namespace
+
+   AsyncLogSink::Buffer::Buffer(AsyncLogSink &sink)
+   :  sink_(sink)
+{
+   this->setp(line_, line_ + sizeof(line_));
+}
+
+void AsyncLogSink::Buffer::pushLine()
+{
+   sink_.push(this->pbase(), this->pptr() - this->pbase());
+   this->setp(line_, line_ + sizeof(line_));
+}
+
+AsyncLogSink::Buffer::int_type AsyncLogSink::Buffer::overflow(int_type c)
+{
+   this->pushLine();
+
+   if(!traits_type::eq_int_type(c, traits_type::eof())) {
+      *this->pptr() = traits_type::to_char_type(c);
+      this->pbump(1);
+   }
+
+   return traits_type::not_eof(c);
+}
+
+int AsyncLogSink::Buffer::sync()
+{
+   this->pushLine();
+   return 0;
+}
+
+   AsyncLogSink::AsyncLogSink(std::ostream &target, size_t capacity)
+   :  target_(target.rdbuf()),
+      ring_(roundUpToPowerOfTwo(capacity)),
+      mask_(ring_.size() - 1),
+      buffer_(*this),
+      stream_(&buffer_),
+      thread_(&AsyncLogSink::run, this)
+{
+   registerBackgroundThread("AsyncLogSink");
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+   if(installed_stream_) {
+      installed_stream_->rdbuf(installed_stream_buffer_);
+   }
+
+   buffer_.pubsync();
+
+   stop_requested_ = true;
+   thread_.join();
+   
+   unregisterBackgroundThread("AsyncLogSink");
+
+   this->drain();
+   target_->pubsync();
+}
+
+void AsyncLogSink::install(std::ostream &stream)
+{
+   if(installed_stream_) {
+      installed_stream_->rdbuf(installed_stream_buffer_);
+   }
+
+   installed_stream_ = &stream;
+   installed_stream_buffer_ = stream.rdbuf(&buffer_);
+}
+
+void AsyncLogSink::flush()
+{
+   buffer_.pubsync();
+
+   size_t head = head_.load(std::memory_order_relaxed);
+   while(tail_.load(std::memory_order_acquire) != head) {
+      std::this_thread::yield();
+   }
+}
+
+void AsyncLogSink::push(const char *data, size_t size)
+{
+   size_t head = head_.load(std::memory_order_relaxed);
+
+   while(size > 0) {
+
+      size_t free_space = ring_.size() - (head - tail_.load(std::memory_order_acquire));
+
+      // The ring buffer is full. Wait for the background thread.
+      //
+      if(free_space == 0) {
+         std::this_thread::yield();
+         continue;
+      }
+
+      size_t n = std::min(size, free_space);
+      size_t offset = head & mask_;
+      size_t n_first = std::min(n, ring_.size() - offset);
+
+      std::memcpy(&ring_[offset], data, n_first);
+      std::memcpy(&ring_[0], data + n_first, n - n_first);
+
+      head += n;
+      data += n;
+      size -= n;
+
+      head_.store(head, std::memory_order_release);
+   }
+}
+
+bool AsyncLogSink::drain()
+{
+   size_t head = head_.load(std::memory_order_acquire);
+   size_t tail = tail_.load(std::memory_order_relaxed);
+
+   if(head == tail) { return false; }
+
+   size_t n = head - tail;
+   size_t offset = tail & mask_;
+   size_t n_first = std::min(n, ring_.size() - offset);
+
+   target_->sputn(&ring_[offset], n_first);
+   target_->sputn(&ring_[0], n - n_first);
+   target_->pubsync();
+
+   tail_.store(head, std::memory_order_release);
+
+   return true;
+}
+
+void AsyncLogSink::run()
+{
+   while(!stop_requested_) {
+      if(!this->drain()) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+   }
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
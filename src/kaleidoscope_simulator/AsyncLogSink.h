@@ -0,0 +1,142 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <stddef.h>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief An output stream sink that writes asynchronously.
+/// @details Text written to the sink's stream is collected in a
+///        line buffer. When the stream is flushed or the line buffer
+///        is full, its content is pushed to a lock-free single-producer
+///        single-consumer ring buffer. A background thread drains the ring
+///        buffer to the target stream. Writing therefore never waits for
+///        terminal or file I/O, unless the ring buffer is full.
+///
+///        Only a single thread may write to the sink. The sink is opt-in.
+///        Either construct a simulator with the sink's stream or
+///        install the sink in an existing stream, e.g. std::cout, which
+///        is used by Simulator::getInstance().
+///
+///        While a sink exists, Simulator::checkpoint() and 
+///        ParallelTestRunner::run(...) do not fork, as fork() does not 
+///        copy the background thread.
+///
+///        @code
+///        AsyncLogSink log_sink(std::cout);
+///        log_sink.install(std::cout);
+///        @endcode
+///
+class AsyncLogSink
+{
+   public:
+
+      /// @brief Constructor. Starts the background thread.
+      /// @param target The stream that receives the output. Its stream
+      ///        buffer must outlive the sink.
+      /// @param capacity The capacity of the ring buffer [bytes]. Rounded up
+      ///        to a power of two.
+      ///
+      AsyncLogSink(std::ostream &target, size_t capacity = 1 << 20);
+
+      /// @brief Destructor. Uninstalls the sink, writes all
+      ///        pending output and stops the background thread.
+      ///
+      ~AsyncLogSink();
+
+      AsyncLogSink(const AsyncLogSink &) = delete;
+      AsyncLogSink &operator=(const AsyncLogSink &) = delete;
+
+      /// @brief The stream that writes to the sink.
+      ///
+      std::ostream &getStream() { return stream_; }
+
+      /// @brief Makes a stream write to the sink.
+      /// @details The stream's original stream buffer is restored when
+      ///        the sink is destroyed. Only one stream can be installed.
+      /// @param stream The stream.
+      ///
+      void install(std::ostream &stream);
+
+      /// @brief Blocks until all output written so far has been passed to
+      ///        the target stream.
+      ///
+      void flush();
+
+   private:
+
+      class Buffer : public std::streambuf
+      {
+         public:
+
+            Buffer(AsyncLogSink &sink);
+
+         protected:
+
+            virtual int_type overflow(int_type c) override;
+            virtual int sync() override;
+
+         private:
+
+            void pushLine();
+
+         private:
+
+            AsyncLogSink &sink_;
+            char line_[4096];
+      };
+
+      void push(const char *data, size_t size);
+      bool drain();
+      void run();
+
+   private:
+
+      std::streambuf *target_;
+
+      std::vector<char> ring_;
+      size_t mask_;
+
+      // Written by the producer only.
+      //
+      std::atomic<size_t> head_{0};
+
+      // Written by the background thread only.
+      //
+      std::atomic<size_t> tail_{0};
+
+      Buffer buffer_;
+      std::ostream stream_;
+
+      std::ostream *installed_stream_ = nullptr;
+      std::streambuf *installed_stream_buffer_ = nullptr;
+
+      std::atomic<bool> stop_requested_{false};
+      std::thread thread_;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,515 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/Benchmark.h"
+#include "kaleidoscope_simulator/Simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace kaleidoscope {
+namespace simulator {
+
+namespace {
+
+// Nearest-rank percentile of sorted values.
+//
+double percentile(const std::vector<double> &sorted, double p)
+{
+   if(sorted.empty()) { return 0.0; }
+
+   auto rank = static_cast<std::size_t>(std::ceil(p/100.0*sorted.size()));
+   if(rank < 1) { rank = 1; }
+   if(rank > sorted.size()) { rank = sorted.size(); }
+
+   return sorted[rank - 1];
+}
+
+void writeJSONString(std::ostream &out, const std::string &s)
+{
+   out << '"';
+   for(char c: s) {
+      if(c == '"' || c == '\\') { out << '\\'; }
+      out << c;
+   }
+   out << '"';
+}
+
+std::string trim(const std::string &s)
+{
+   auto begin = s.find_first_not_of(" \t\r");
+   if(begin == std::string::npos) { return std::string{}; }
+   auto end = s.find_last_not_of(" \t\r");
+   return s.substr(begin, end - begin + 1);
+}
+
+bool parseDouble(const std::string &s, double &value)
+{
+   if(s.empty()) { return false; }
+   char *end = nullptr;
+   value = std::strtod(s.c_str(), &end);
+   return *end == '\0';
+}
+
+// Parses a baseline value and its tolerance. Both are "-" if the value
+// is not checked.
+//
+bool parseBaselineValue(const std::string &value_field, 
+                        const std::string &tolerance_field,
+                        bool &check, double &value, double &tolerance)
+{
+   check = (value_field != "-");
+   
+   if(!check) {
+      return tolerance_field == "-";
+   }
+   
+   return parseDouble(value_field, value) 
+       && parseDouble(tolerance_field, tolerance);
+}
+
+// Relative deviation from a baseline value [%], formatted with sign.
+//
+std::string deviation(double value, double baseline)
+{
+   double percent = 0.0;
+   if(baseline != 0.0) {
+      percent = (value - baseline)/baseline*100.0;
+   }
+   else if(value != 0.0) {
+      percent = 100.0;
+   }
+
+   std::ostringstream out;
+   out << std::showpos << std::fixed << std::setprecision(1) << percent;
+   return out.str();
+}
+
+bool exceeds(double value, double baseline, double tolerance)
+{
+   // Absolute slack avoids false alarms due to rounding of the
+   // values stored in the baseline file.
+   //
+   return value > baseline*(1.0 + tolerance/100.0) + 1e-6;
+}
+
+} // namespace
+
+   Benchmark::Benchmark(Simulator &simulator)
+   :  simulator_(simulator)
+{
+   const char *json_file = std::getenv("KALEIDOSCOPE_SIMULATOR_BENCHMARK_JSON");
+   if(json_file) {
+      json_file_ = json_file;
+   }
+
+   const char *baseline_file = std::getenv("KALEIDOSCOPE_SIMULATOR_BENCHMARK_BASELINE");
+   if(baseline_file) {
+      baseline_file_ = baseline_file;
+   }
+
+   const char *write_baseline = std::getenv("KALEIDOSCOPE_SIMULATOR_BENCHMARK_WRITE_BASELINE");
+   write_baseline_ = write_baseline && (write_baseline[0] != '\0')
+                        && (std::strcmp(write_baseline, "0") != 0);
+}
+
+void Benchmark::addScenario(const char *name,
+                            std::function<void()> sample_function,
+                            std::function<void()> setup_function)
+{
+   this->addScenario(name, 0, std::move(sample_function), std::move(setup_function));
+}
+
+void Benchmark::addScenario(const char *name,
+                            int n_keystrokes_per_sample,
+                            std::function<void()> sample_function,
+                            std::function<void()> setup_function)
+{
+   scenarios_.push_back(Scenario{name, n_keystrokes_per_sample,
+                                 std::move(sample_function),
+                                 std::move(setup_function)});
+}
+
+Benchmark::ScenarioResult Benchmark::runScenario(const Scenario &scenario)
+{
+   typedef std::chrono::steady_clock Clock;
+
+   ScenarioResult result;
+   result.name = scenario.name;
+   result.n_keystrokes_per_sample = scenario.n_keystrokes_per_sample;
+
+   if(scenario.setup_function) {
+      scenario.setup_function();
+   }
+
+   for(int i = 0; i < n_warmup_samples_; ++i) {
+      scenario.sample_function();
+   }
+
+   std::vector<double> cycle_times;
+   cycle_times.reserve(n_samples_);
+
+   long n_cycles_total = 0;
+   uint64_t n_reports_total = 0;
+
+   for(int i = 0; i < n_samples_; ++i) {
+
+      int start_cycle = simulator_.getCurrentCycle();
+      uint64_t start_reports = simulator_.getNumHIDReports();
+      auto start = Clock::now();
+
+      scenario.sample_function();
+
+      auto end = Clock::now();
+      int n_cycles = simulator_.getCurrentCycle() - start_cycle;
+
+      if(n_cycles <= 0) { continue; }
+
+      n_reports_total += simulator_.getNumHIDReports() - start_reports;
+
+      n_cycles_total += n_cycles;
+      cycle_times.push_back(
+         std::chrono::duration<double, std::nano>(end - start).count()/n_cycles);
+   }
+
+   std::sort(cycle_times.begin(), cycle_times.end());
+
+   result.n_samples = static_cast<int>(cycle_times.size());
+
+   if(!cycle_times.empty()) {
+      result.cycles_per_sample = double(n_cycles_total)/cycle_times.size();
+      result.median = percentile(cycle_times, 50);
+      result.p90 = percentile(cycle_times, 90);
+      result.p99 = percentile(cycle_times, 99);
+      result.min = cycle_times.front();
+      result.max = cycle_times.back();
+
+      if(scenario.n_keystrokes_per_sample > 0) {
+         result.reports_per_keystroke = double(n_reports_total)
+            /(double(scenario.n_keystrokes_per_sample)*cycle_times.size());
+      }
+   }
+
+   return result;
+}
+
+void Benchmark::logResult(const ScenarioResult &result)
+{
+   if(result.n_samples == 0) {
+      simulator_.error() << "Benchmark scenario \"" << result.name
+         << "\" did not run any cycles";
+      return;
+   }
+
+   simulator_.log() << "Benchmark \"" << result.name << "\": "
+      << result.n_samples << " samples, "
+      << result.cycles_per_sample << " cycles/sample, cycle time [ns]: median "
+      << result.median << ", p90 " << result.p90 << ", p99 " << result.p99
+      << ", min " << result.min << ", max " << result.max;
+
+   if(result.n_keystrokes_per_sample > 0) {
+      simulator_.log() << "Benchmark \"" << result.name << "\": "
+         << result.reports_per_keystroke << " reports/keystroke";
+   }
+}
+
+bool Benchmark::writeJSON() const
+{
+   std::ofstream out(json_file_);
+
+   if(!out) {
+      simulator_.error() << "Unable to open benchmark output file \""
+         << json_file_ << "\"";
+      return false;
+   }
+
+   out << "{\n  \"scenarios\": [";
+
+   for(std::size_t i = 0; i < results_.size(); ++i) {
+      const auto &result = results_[i];
+      out << ((i == 0) ? "\n" : ",\n") << "    {\"name\": ";
+      writeJSONString(out, result.name);
+      out << ", \"samples\": " << result.n_samples
+          << ", \"cycles_per_sample\": " << result.cycles_per_sample
+          << ", \"median_ns\": " << result.median
+          << ", \"p90_ns\": " << result.p90
+          << ", \"p99_ns\": " << result.p99
+          << ", \"min_ns\": " << result.min
+          << ", \"max_ns\": " << result.max
+          << ", \"keystrokes_per_sample\": " << result.n_keystrokes_per_sample
+          << ", \"reports_per_keystroke\": " << result.reports_per_keystroke << "}";
+   }
+
+   out << "\n  ]\n}\n";
+
+   return static_cast<bool>(out);
+}
+
+bool Benchmark::readBaseline(std::vector<BaselineEntry> &baseline) const
+{
+   std::ifstream in(baseline_file_);
+
+   if(!in) {
+      simulator_.error() << "Unable to read benchmark baseline file \""
+         << baseline_file_ << "\"";
+      return false;
+   }
+
+   return this->readBaseline(in, "file \"" + baseline_file_ + "\"", baseline);
+}
+
+bool Benchmark::readBaseline(std::istream &in, const std::string &source,
+                             std::vector<BaselineEntry> &baseline) const
+{
+   std::string line;
+   int line_number = 0;
+
+   while(std::getline(in, line)) {
+
+      ++line_number;
+
+      line = trim(line);
+      if(line.empty() || (line[0] == '#')) { continue; }
+
+      std::vector<std::string> fields;
+      std::istringstream line_stream(line);
+      std::string field;
+      while(std::getline(line_stream, field, ';')) {
+         fields.push_back(trim(field));
+      }
+
+      BaselineEntry entry;
+
+      if((fields.size() != 5)
+            || fields[0].empty()
+            || !parseBaselineValue(fields[1], fields[2], entry.check_cycle_time,
+                                   entry.cycle_time, entry.cycle_time_tolerance)
+            || !parseBaselineValue(fields[3], fields[4], entry.check_reports,
+                                   entry.reports_per_keystroke, entry.reports_tolerance)) {
+         simulator_.error() << "Malformed benchmark baseline entry in line "
+            << line_number << " of " << source;
+         return false;
+      }
+
+      entry.name = fields[0];
+      baseline.push_back(entry);
+   }
+
+   return true;
+}
+
+bool Benchmark::writeBaseline(const std::vector<BaselineEntry> &old_baseline) const
+{
+   std::ofstream out(baseline_file_);
+
+   if(!out) {
+      simulator_.error() << "Unable to write benchmark baseline file \""
+         << baseline_file_ << "\"";
+      return false;
+   }
+
+   out << "# scenario ; median cycle time [ns] ; tolerance [%]"
+          " ; reports per keystroke ; tolerance [%]\n";
+
+   for(const auto &result: results_) {
+
+      BaselineEntry entry;
+      entry.cycle_time_tolerance = default_cycle_time_tolerance_;
+      entry.reports_tolerance = default_reports_tolerance_;
+
+      // Tolerances and disabled checks are preserved.
+      //
+      for(const auto &old_entry: old_baseline) {
+         if(old_entry.name == result.name) {
+            entry = old_entry;
+            break;
+         }
+      }
+
+      out << result.name << " ; " << std::fixed << std::setprecision(1);
+      
+      if(entry.check_cycle_time) {
+         out << result.median << " ; " << entry.cycle_time_tolerance << " ; ";
+      }
+      else {
+         out << "- ; - ; ";
+      }
+      
+      if(entry.check_reports) {
+         out << std::setprecision(4) << result.reports_per_keystroke << " ; "
+             << std::setprecision(1) << entry.reports_tolerance << "\n";
+      }
+      else {
+         out << "- ; -\n";
+      }
+   }
+
+   simulator_.log() << "Benchmark baseline written to \"" << baseline_file_ << "\"";
+
+   return static_cast<bool>(out);
+}
+
+bool Benchmark::checkBaseline(const std::vector<BaselineEntry> &baseline)
+{
+   bool success = true;
+
+   if(baseline_file_.empty()) {
+      simulator_.log() << "Benchmark results compared to built-in baseline:";
+   }
+   else {
+      simulator_.log() << "Benchmark results compared to baseline \""
+         << baseline_file_ << "\":";
+   }
+
+   for(const auto &result: results_) {
+
+      const BaselineEntry *entry = nullptr;
+      for(const auto &candidate: baseline) {
+         if(candidate.name == result.name) {
+            entry = &candidate;
+            break;
+         }
+      }
+
+      if(!entry) {
+         simulator_.log() << "   " << result.name << ": no baseline";
+         continue;
+      }
+
+      if(entry->check_cycle_time) {
+         
+         bool cycle_time_regressed
+            = exceeds(result.median, entry->cycle_time, entry->cycle_time_tolerance);
+
+         simulator_.log() << "   " << result.name << ": cycle time "
+            << result.median << " ns (baseline " << entry->cycle_time << " ns, "
+            << deviation(result.median, entry->cycle_time)
+            << " %, tolerance " << entry->cycle_time_tolerance
+            << " %)" << (cycle_time_regressed ? " REGRESSION" : "");
+
+         if(cycle_time_regressed) {
+            simulator_.error() << "Benchmark scenario \"" << result.name
+               << "\" regressed: median cycle time " << result.median
+               << " ns exceeds baseline " << entry->cycle_time << " ns by more than "
+               << entry->cycle_time_tolerance << " %";
+            success = false;
+         }
+      }
+
+      if(!entry->check_reports || (result.n_keystrokes_per_sample == 0)) { continue; }
+
+      bool reports_regressed
+         = exceeds(result.reports_per_keystroke, entry->reports_per_keystroke,
+                   entry->reports_tolerance);
+
+      simulator_.log() << "   " << result.name << ": reports/keystroke "
+         << result.reports_per_keystroke << " (baseline "
+         << entry->reports_per_keystroke << ", "
+         << deviation(result.reports_per_keystroke, entry->reports_per_keystroke)
+         << " %, tolerance " << entry->reports_tolerance
+         << " %)" << (reports_regressed ? " REGRESSION" : "");
+
+      if(reports_regressed) {
+         simulator_.error() << "Benchmark scenario \"" << result.name
+            << "\" regressed: " << result.reports_per_keystroke
+            << " reports per keystroke exceed baseline "
+            << entry->reports_per_keystroke << " by more than "
+            << entry->reports_tolerance << " %";
+         success = false;
+      }
+   }
+
+   for(const auto &entry: baseline) {
+      bool found = false;
+      for(const auto &result: results_) {
+         if(result.name == entry.name) { found = true; break; }
+      }
+      if(!found) {
+         simulator_.log() << "   " << entry.name << ": not run";
+      }
+   }
+
+   return success;
+}
+
+bool Benchmark::run()
+{
+   results_.clear();
+
+   // Reports are a by-product of the scenarios. Nobody is
+   // going to check them.
+   //
+   bool error_if_report_without_queued_actions
+      = simulator_.getErrorIfReportWithoutQueuedActions();
+   simulator_.setErrorIfReportWithoutQueuedActions(false);
+
+   bool quiet = simulator_.isQuiet();
+
+   for(const auto &scenario: scenarios_) {
+      simulator_.setQuiet(true);
+      results_.push_back(this->runScenario(scenario));
+      simulator_.setQuiet(quiet);
+
+      this->logResult(results_.back());
+   }
+
+   simulator_.setErrorIfReportWithoutQueuedActions(
+      error_if_report_without_queued_actions);
+
+   bool success = true;
+
+   if(!json_file_.empty()) {
+      success = this->writeJSON() && success;
+   }
+
+   std::vector<BaselineEntry> baseline;
+   
+   if(baseline_file_.empty()) {
+      
+      if(baseline_.empty() || write_baseline_) { return success; }
+      
+      std::istringstream in(baseline_);
+      if(!this->readBaseline(in, "the built-in baseline", baseline)) { return false; }
+      
+      return this->checkBaseline(baseline) && success;
+   }
+
+   if(write_baseline_) {
+
+      // Tolerances of an existing baseline are preserved.
+      //
+      if(std::ifstream(baseline_file_)) {
+         this->readBaseline(baseline);
+      }
+
+      return this->writeBaseline(baseline) && success;
+   }
+
+   if(!this->readBaseline(baseline)) { return false; }
+
+   return this->checkBaseline(baseline) && success;
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
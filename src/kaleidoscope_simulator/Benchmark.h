@@ -0,0 +1,227 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace kaleidoscope {
+namespace simulator {
+
+class Simulator;
+
+/// @brief Measures the firmware's scan cycle cost in named scenarios.
+/// @details A scenario consists of an optional setup function and
+///        a sample function. The setup function is run once before
+///        the scenario's samples are taken. Every call to the sample function
+///        is one sample. It may run an arbitrary number of scan cycles.
+///        The cycle time of a sample is its wall clock duration
+///        divided by the number of cycles it ran.
+///
+///        Before measuring, a number of warm-up samples is run
+///        whose timing is discarded. Timing uses a monotonic clock.
+///        Log output is suppressed while samples are taken.
+///
+///        Results are logged and, if a file name is set (see setJSONFile(...))
+///        written as JSON. The JSON file name defaults to the value of
+///        the environment variable KALEIDOSCOPE_SIMULATOR_BENCHMARK_JSON.
+///
+///        If a baseline file is set (see setBaselineFile(...)), results
+///        are compared to the baseline. A scenario regresses if its median
+///        cycle time or its number of HID reports per keystroke exceeds
+///        the baseline value by more than the scenario's tolerance.
+///        Regressions are reported as errors. Alternatively, the results
+///        of a run can be written as a new baseline (see setWriteBaseline(...)).
+///        The baseline file name and baseline writing default to
+///        the values of the environment variables 
+///        KALEIDOSCOPE_SIMULATOR_BENCHMARK_BASELINE and
+///        KALEIDOSCOPE_SIMULATOR_BENCHMARK_WRITE_BASELINE (any non-empty
+///        value other than 0 enables writing).
+///
+///        The baseline file is a text file with one scenario per line.
+///        Fields are separated by semicolons. Lines starting with '#' are
+///        comments. A value and its tolerance can both be "-", which
+///        disables the check. As cycle times depend on the machine, a
+///        baseline that is shared between machines should only define
+///        reports per keystroke.
+///        
+///        @code
+///        # scenario ; median cycle time [ns] ; tolerance [%] ; reports per keystroke ; tolerance [%]
+///        typing burst ; 1250 ; 25 ; 2 ; 0
+///        full rollover ; - ; - ; 0.0667 ; 0
+///        @endcode
+///
+///        Instead of a file, a baseline can be passed as string 
+///        (see setBaseline(...)). It is used if no baseline file is set.
+///
+class Benchmark
+{
+   public:
+
+      /// @brief Timing results of a scenario.
+      ///
+      struct ScenarioResult {
+         std::string name;
+         int n_samples = 0;
+         double cycles_per_sample = 0.0;
+         double median = 0.0; ///< Cycle time [ns]
+         double p90 = 0.0;    ///< Cycle time [ns]
+         double p99 = 0.0;    ///< Cycle time [ns]
+         double min = 0.0;    ///< Cycle time [ns]
+         double max = 0.0;    ///< Cycle time [ns]
+         int n_keystrokes_per_sample = 0;
+         double reports_per_keystroke = 0.0;
+      };
+
+      /// @brief Constructor.
+      /// @param simulator The simulator that runs the scenarios.
+      ///
+      Benchmark(Simulator &simulator);
+
+      /// @brief Sets the number of warm-up samples per scenario.
+      ///
+      void setNumWarmupSamples(int n) { n_warmup_samples_ = n; }
+
+      /// @brief Sets the number of measured samples per scenario.
+      ///
+      void setNumSamples(int n) { n_samples_ = n; }
+
+      /// @brief Sets the name of the JSON output file.
+      /// @param file_name The file name. If empty, no JSON output
+      ///        is generated.
+      ///
+      void setJSONFile(const std::string &file_name) { json_file_ = file_name; }
+
+      /// @brief Sets the name of the baseline file.
+      /// @param file_name The file name. If empty, results are not
+      ///        compared to a baseline.
+      ///
+      void setBaselineFile(const std::string &file_name) { baseline_file_ = file_name; }
+
+      /// @brief Sets a baseline that is used if no baseline file is set.
+      /// @details This allows a benchmark to ship with a built-in baseline
+      ///        that is checked by default.
+      /// @param baseline The content of a baseline file.
+      ///
+      void setBaseline(const std::string &baseline) { baseline_ = baseline; }
+
+      /// @brief Enables or disables writing the results as new baseline.
+      /// @details When enabled, results are not compared to the baseline.
+      ///        Tolerances of scenarios that are already part of
+      ///        the baseline file are preserved.
+      ///
+      void setWriteBaseline(bool state) { write_baseline_ = state; }
+
+      /// @brief Sets the tolerances of scenarios that are not yet part
+      ///        of the baseline when a new baseline is written.
+      /// @param cycle_time_tolerance The tolerance of the median cycle time [%].
+      /// @param reports_tolerance The tolerance of the reports per keystroke [%].
+      ///
+      void setDefaultTolerances(double cycle_time_tolerance,
+                                double reports_tolerance) {
+         default_cycle_time_tolerance_ = cycle_time_tolerance;
+         default_reports_tolerance_ = reports_tolerance;
+      }
+
+      /// @brief Registers a scenario.
+      /// @param name The name of the scenario. Must be unique.
+      /// @param sample_function A function that runs one sample.
+      /// @param setup_function A function that is run once before the
+      ///        scenario's samples are taken.
+      ///
+      void addScenario(const char *name,
+                       std::function<void()> sample_function,
+                       std::function<void()> setup_function = std::function<void()>{});
+
+      /// @brief Registers a scenario that generates keystrokes.
+      /// @details For such scenarios the number of HID reports per
+      ///        keystroke is reported and checked against the baseline.
+      /// @param name The name of the scenario. Must be unique.
+      /// @param n_keystrokes_per_sample The number of keystrokes
+      ///        every sample generates.
+      /// @param sample_function A function that runs one sample.
+      /// @param setup_function A function that is run once before the
+      ///        scenario's samples are taken.
+      ///
+      void addScenario(const char *name,
+                       int n_keystrokes_per_sample,
+                       std::function<void()> sample_function,
+                       std::function<void()> setup_function = std::function<void()>{});
+
+      /// @brief Runs all registered scenarios in the order they were registered.
+      /// @returns True if the results could be written and no scenario
+      ///        regressed.
+      ///
+      bool run();
+
+      /// @brief Access the results of the last run.
+      ///
+      const std::vector<ScenarioResult> &getResults() const { return results_; }
+
+   private:
+
+      struct Scenario {
+         std::string name;
+         int n_keystrokes_per_sample;
+         std::function<void()> sample_function;
+         std::function<void()> setup_function;
+      };
+
+      struct BaselineEntry {
+         std::string name;
+         bool check_cycle_time = true;
+         double cycle_time = 0.0;          // [ns]
+         double cycle_time_tolerance = 0.0; // [%]
+         bool check_reports = true;
+         double reports_per_keystroke = 0.0;
+         double reports_tolerance = 0.0;   // [%]
+      };
+
+      ScenarioResult runScenario(const Scenario &scenario);
+
+      void logResult(const ScenarioResult &result);
+      bool writeJSON() const;
+
+      bool readBaseline(std::vector<BaselineEntry> &baseline) const;
+      bool readBaseline(std::istream &in, const std::string &source,
+                        std::vector<BaselineEntry> &baseline) const;
+      bool writeBaseline(const std::vector<BaselineEntry> &old_baseline) const;
+      bool checkBaseline(const std::vector<BaselineEntry> &baseline);
+
+   private:
+
+      Simulator &simulator_;
+
+      int n_warmup_samples_ = 10;
+      int n_samples_ = 100;
+      std::string json_file_;
+      std::string baseline_file_;
+      std::string baseline_;
+      bool write_baseline_ = false;
+      double default_cycle_time_tolerance_ = 25.0;
+      double default_reports_tolerance_ = 0.0;
+
+      std::vector<Scenario> scenarios_;
+      std::vector<ScenarioResult> results_;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,89 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/HostEventBackend.h"
+
+#ifdef __unix__
+#include "kaleidoscope_simulator/XTestHostEventBackend.h"
+#endif
+
+namespace kaleidoscope {
+namespace simulator {
+   
+void RecordingHostEventBackend::add(Event::Type type, uint8_t code, 
+                                    int32_t value, int32_t value2)
+{
+   ++n_events_;
+   
+   if(record_) {
+      events_.push_back(Event{type, code, value, value2});
+   }
+}
+
+void RecordingHostEventBackend::keyEvent(uint8_t hid_keycode, bool pressed)
+{
+   this->add(Event::key, hid_keycode, pressed);
+}
+
+void RecordingHostEventBackend::buttonEvent(uint8_t button, bool pressed)
+{
+   this->add(Event::button, button, pressed);
+}
+
+void RecordingHostEventBackend::relativeMotionEvent(int dx, int dy)
+{
+   this->add(Event::relative_motion, 0, dx, dy);
+}
+
+void RecordingHostEventBackend::absoluteMotionEvent(double x, double y)
+{
+   this->add(Event::absolute_motion, 0, int32_t(x*65536), int32_t(y*65536));
+}
+
+void RecordingHostEventBackend::wheelEvent(int vertical, int horizontal)
+{
+   this->add(Event::wheel, 0, vertical, horizontal);
+}
+
+void RecordingHostEventBackend::flush()
+{
+   this->add(Event::flush, 0, 0);
+}
+
+void RecordingHostEventBackend::sync()
+{
+   this->add(Event::sync, 0, 0);
+}
+
+void RecordingHostEventBackend::clear()
+{
+   events_.clear();
+   n_events_ = 0;
+}
+
+std::shared_ptr<HostEventBackend> createDefaultHostEventBackend()
+{
+#ifdef __unix__
+   return std::make_shared<XTestHostEventBackend>();
+#else
+   return std::make_shared<RecordingHostEventBackend>(false /* record */);
+#endif
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,163 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief The interface of the host systems that receive the events
+///        generated by the GenerateHostEvent report actions.
+/// @details Backends receive HID keycodes and mouse events. They
+///        translate them into events of the host system. Events may be
+///        queued until flush() is called.
+///
+class HostEventBackend
+{
+   public:
+      
+      virtual ~HostEventBackend() {}
+      
+      /// @brief Generates a key event.
+      /// @param hid_keycode The HID keycode (modifiers are 0xE0 to 0xE7).
+      /// @param pressed True for a key press, false for a release.
+      ///
+      virtual void keyEvent(uint8_t hid_keycode, bool pressed) = 0;
+      
+      /// @brief Generates a mouse button event.
+      /// @param button The mouse button (1 = left, 2 = middle, 3 = right).
+      /// @param pressed True for a button press, false for a release.
+      ///
+      virtual void buttonEvent(uint8_t button, bool pressed) = 0;
+      
+      /// @brief Generates a relative mouse movement.
+      /// @param dx The horizontal movement.
+      /// @param dy The vertical movement.
+      ///
+      virtual void relativeMotionEvent(int dx, int dy) = 0;
+      
+      /// @brief Moves the mouse pointer to an absolute position.
+      /// @param x The horizontal position as a fraction of the screen width
+      ///        in the range [0, 1].
+      /// @param y The vertical position as a fraction of the screen height
+      ///        in the range [0, 1].
+      ///
+      virtual void absoluteMotionEvent(double x, double y) = 0;
+      
+      /// @brief Generates scroll wheel movement.
+      /// @param vertical The vertical movement [ticks] (positive = up).
+      /// @param horizontal The horizontal movement [ticks] (positive = left).
+      ///
+      virtual void wheelEvent(int vertical, int horizontal) = 0;
+      
+      /// @brief Sends all queued events to the host system.
+      ///
+      virtual void flush() {}
+      
+      /// @brief Sends all queued events to the host system and waits until
+      ///        they have been processed.
+      ///
+      virtual void sync() { this->flush(); }
+};
+
+/// @brief A host event backend that records events in memory.
+/// @details Allows for testing and benchmarking host event generation
+///        without a host system, e.g. on headless machines.
+///
+///        @code
+///        auto backend = std::make_shared<RecordingHostEventBackend>();
+///        HostEventAction::setBackend(backend);
+///        simulator.permanentKeyboardReportActions().add(GenerateHostEvent<KeyboardReport>{});
+///        ...
+///        for(const auto &event: backend->getEvents()) { ... }
+///        @endcode
+///
+class RecordingHostEventBackend : public HostEventBackend
+{
+   public:
+      
+      /// @brief A recorded host event.
+      ///
+      struct Event {
+         
+         enum Type : uint8_t {
+            key,              ///< code: HID keycode, value: pressed
+            button,           ///< code: button, value: pressed
+            relative_motion,  ///< value: dx, value2: dy
+            absolute_motion,  ///< value: x, value2: y [1/65536 of the screen]
+            wheel,            ///< value: vertical, value2: horizontal ticks
+            flush,
+            sync
+         };
+         
+         Type type;
+         uint8_t code;
+         int32_t value;
+         int32_t value2;
+      };
+      
+      /// @brief Constructor.
+      /// @param record If false, events are only counted, not stored.
+      ///
+      RecordingHostEventBackend(bool record = true) : record_(record) {}
+      
+      virtual void keyEvent(uint8_t hid_keycode, bool pressed) override;
+      virtual void buttonEvent(uint8_t button, bool pressed) override;
+      virtual void relativeMotionEvent(int dx, int dy) override;
+      virtual void absoluteMotionEvent(double x, double y) override;
+      virtual void wheelEvent(int vertical, int horizontal) override;
+      virtual void flush() override;
+      virtual void sync() override;
+      
+      /// @brief The recorded events.
+      ///
+      const std::vector<Event> &getEvents() const { return events_; }
+      
+      /// @brief The number of events received, including events that
+      ///        were not stored.
+      ///
+      uint64_t getNumEvents() const { return n_events_; }
+      
+      /// @brief Discards all recorded events and resets the event count.
+      ///
+      void clear();
+      
+   private:
+      
+      void add(Event::Type type, uint8_t code, int32_t value, int32_t value2 = 0);
+      
+   private:
+      
+      bool record_;
+      std::vector<Event> events_;
+      uint64_t n_events_ = 0;
+};
+
+/// @brief Creates the default host event backend of the platform.
+/// @details On unixoid systems, this is an XTestHostEventBackend. On other 
+///        platforms, host events are not supported and a recording 
+///        backend is returned.
+///
+std::shared_ptr<HostEventBackend> createDefaultHostEventBackend();
+
+} // namespace simulator
+} // namespace kaleidoscope
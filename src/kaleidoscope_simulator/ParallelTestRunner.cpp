@@ -0,0 +1,324 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/ParallelTestRunner.h"
+#include "kaleidoscope_simulator/Simulator.h"
+#include "kaleidoscope_simulator/ReportTrace.h"
+#include "kaleidoscope_simulator/aux/BackgroundThreads.h"
+
+#include <stdint.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KS_T_HAVE_FORK
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+namespace kaleidoscope {
+namespace simulator {
+
+namespace {
+
+/// @private
+///
+struct ResultRecord {
+   uint32_t test_id;
+   uint8_t passed;
+   double duration;
+};
+
+} // namespace
+
+   ParallelTestRunner::ParallelTestRunner(Simulator &simulator)
+   :  simulator_(simulator)
+{
+}
+
+void ParallelTestRunner::addTest(const char *name,
+                                 std::function<void()> test_function)
+{
+   test_names_.push_back(name);
+   test_functions_.push_back(std::move(test_function));
+}
+
+ParallelTestRunner::TestResult ParallelTestRunner::runTest(std::size_t test_id)
+{
+   TestResult result;
+
+   auto n_errors = simulator_.getErrorCount();
+   auto start = std::chrono::steady_clock::now();
+
+   {
+      auto test = simulator_.newTest(test_names_[test_id].c_str());
+      test_functions_[test_id]();
+   }
+
+   auto end = std::chrono::steady_clock::now();
+
+   result.completed = true;
+   result.passed = (simulator_.getErrorCount() == n_errors);
+   result.duration = std::chrono::duration<double>(end - start).count();
+
+   return result;
+}
+
+void ParallelTestRunner::runSequentially()
+{
+   for(std::size_t test_id = 0; test_id < test_functions_.size(); ++test_id) {
+      results_[test_id] = this->runTest(test_id);
+   }
+}
+
+#ifdef KS_T_HAVE_FORK
+
+void ParallelTestRunner::runForked(int n_workers)
+{
+   struct Worker {
+      pid_t pid;
+      int result_fd;
+      std::FILE *log_file;
+   };
+
+   // The workers would lack the background thread, while
+   // output that it buffered would be written by several processes.
+   //
+   if(auto thread_name = getRunningBackgroundThread()) {
+      simulator_.log() << "Running tests sequentially as a " 
+         << thread_name << " is running";
+      this->runSequentially();
+      return;
+   }
+
+   std::vector<Worker> workers;
+
+   ReportTraceWriter::flushAll();
+   std::cout << std::flush;
+   std::fflush(stdout);
+
+   for(int worker_id = 0; worker_id < n_workers; ++worker_id) {
+
+      int fds[2];
+      if(pipe(fds) != 0) {
+         simulator_.error() << "Failed to create pipe for test worker " << worker_id;
+         break;
+      }
+
+      std::FILE *log_file = std::tmpfile();
+
+      pid_t pid = fork();
+
+      if(pid < 0) {
+         simulator_.error() << "Failed to fork test worker " << worker_id;
+         close(fds[0]);
+         close(fds[1]);
+         if(log_file) { std::fclose(log_file); }
+         break;
+      }
+
+      if(pid == 0) {
+
+         // Worker process
+         //
+         close(fds[0]);
+
+         if(log_file) {
+            dup2(fileno(log_file), STDOUT_FILENO);
+         }
+
+         for(std::size_t test_id = worker_id; test_id < test_functions_.size();
+               test_id += n_workers) {
+
+            auto result = this->runTest(test_id);
+
+            ResultRecord record{
+               static_cast<uint32_t>(test_id),
+               static_cast<uint8_t>(result.passed),
+               result.duration
+            };
+
+            // Records are much smaller than PIPE_BUF, so writes are atomic.
+            //
+            if(write(fds[1], &record, sizeof(record)) != sizeof(record)) {
+               break;
+            }
+         }
+
+         close(fds[1]);
+
+         ReportTraceWriter::flushAll();
+         std::cout << std::flush;
+         std::fflush(stdout);
+
+         // Skip any exit handlers. Those belong to the parent process.
+         //
+         _exit(0);
+      }
+
+      close(fds[1]);
+      workers.push_back(Worker{pid, fds[0], log_file});
+   }
+
+   // Results are read from all workers as they arrive. Reading the pipes
+   // one after another would let the workers that are not being read
+   // block as soon as their pipe is full.
+   //
+   std::vector<struct pollfd> poll_fds;
+   for(const auto &worker: workers) {
+      struct pollfd poll_fd = {};
+      poll_fd.fd = worker.result_fd;
+      poll_fd.events = POLLIN;
+      poll_fds.push_back(poll_fd);
+   }
+
+   std::size_t n_open_fds = poll_fds.size();
+
+   while(n_open_fds > 0) {
+
+      if(poll(poll_fds.data(), poll_fds.size(), -1 /* no timeout */) < 0) {
+         if(errno == EINTR) { continue; }
+         simulator_.error() << "Failed to wait for test results";
+         break;
+      }
+
+      for(auto &poll_fd: poll_fds) {
+
+         if((poll_fd.fd < 0) || (poll_fd.revents == 0)) { continue; }
+
+         // Records are written atomically. Thus, a read either returns
+         // a complete record or signals the end of the worker's results.
+         //
+         ResultRecord record;
+         auto n_read = read(poll_fd.fd, &record, sizeof(record));
+
+         if(n_read == sizeof(record)) {
+            if(record.test_id < results_.size()) {
+               auto &result = results_[record.test_id];
+               result.completed = true;
+               result.passed = record.passed;
+               result.duration = record.duration;
+            }
+            continue;
+         }
+
+         if((n_read < 0) && (errno == EINTR)) { continue; }
+
+         close(poll_fd.fd);
+         poll_fd.fd = -1;
+         --n_open_fds;
+      }
+   }
+
+   for(auto &poll_fd: poll_fds) {
+      if(poll_fd.fd >= 0) { close(poll_fd.fd); }
+   }
+
+   for(auto &worker: workers) {
+
+      int status = 0;
+      waitpid(worker.pid, &status, 0);
+
+      if(worker.log_file) {
+         std::rewind(worker.log_file);
+         char buffer[4096];
+         std::size_t n_read;
+         while((n_read = std::fread(buffer, 1, sizeof(buffer), worker.log_file)) > 0) {
+            std::cout.write(buffer, n_read);
+         }
+         std::fclose(worker.log_file);
+      }
+   }
+
+   std::cout << std::flush;
+}
+
+#else
+
+void ParallelTestRunner::runForked(int /*n_workers*/)
+{
+   this->runSequentially();
+}
+
+#endif
+
+bool ParallelTestRunner::reportResults(double wall_time)
+{
+   int n_passed = 0;
+   double cpu_time = 0.0;
+
+   for(std::size_t test_id = 0; test_id < results_.size(); ++test_id) {
+
+      const auto &result = results_[test_id];
+
+      if(!result.completed) {
+         simulator_.error() << "Test \"" << test_names_[test_id]
+            << "\" did not complete (test worker terminated)";
+      }
+      else if(!result.passed) {
+         simulator_.error() << "Test \"" << test_names_[test_id] << "\" failed";
+      }
+      else {
+         ++n_passed;
+      }
+
+      cpu_time += result.duration;
+   }
+
+   simulator_.log() << "Parallel tests: " << n_passed << " of "
+      << results_.size() << " passed";
+   simulator_.log() << "Parallel tests: wall time " << wall_time
+      << " s, accumulated test time " << cpu_time << " s";
+
+   return n_passed == static_cast<int>(results_.size());
+}
+
+bool ParallelTestRunner::run(int n_workers)
+{
+   if(n_workers <= 0) {
+#ifdef KS_T_HAVE_FORK
+      n_workers = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+      if(n_workers <= 0) { n_workers = 1; }
+   }
+
+   if(n_workers > static_cast<int>(test_functions_.size())) {
+      n_workers = static_cast<int>(test_functions_.size());
+   }
+
+   results_.assign(test_functions_.size(), TestResult{});
+
+   auto start = std::chrono::steady_clock::now();
+
+   if(n_workers <= 1) {
+      this->runSequentially();
+   }
+   else {
+      this->runForked(n_workers);
+   }
+
+   auto end = std::chrono::steady_clock::now();
+
+   return this->reportResults(std::chrono::duration<double>(end - start).count());
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
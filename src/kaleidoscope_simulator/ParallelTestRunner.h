@@ -0,0 +1,93 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace kaleidoscope {
+namespace simulator {
+
+class Simulator;
+
+/// @brief Runs a set of tests in parallel worker processes.
+/// @details Tests are registered as functions. When run(...) is called,
+///        the current process is forked once per worker. Every worker
+///        starts from the firmware state at the time run(...) was called
+///        and executes a disjoint subset of the tests. Pass/fail status
+///        and timing are reported back to the parent process through
+///        one pipe per worker. The parent reads all pipes as results arrive.
+///        The log output of every worker is buffered and written
+///        to stdout in worker order after all workers finished.
+///
+///        On platforms without fork() all tests are run sequentially.
+///        The same applies while an AsyncLogSink exists or a RenderThread 
+///        is running, as fork() does not copy their background threads.
+///
+class ParallelTestRunner
+{
+   public:
+
+      /// @brief Constructor.
+      /// @param simulator The simulator that runs the tests.
+      ///
+      ParallelTestRunner(Simulator &simulator);
+
+      /// @brief Registers a test.
+      /// @details The test function is run in the scope of
+      ///        a test object that is created by Simulator::newTest(...).
+      /// @param name The name of the test.
+      /// @param test_function The function that defines the test.
+      ///
+      void addTest(const char *name, std::function<void()> test_function);
+
+      /// @brief Runs all registered tests.
+      /// @param n_workers The number of worker processes. If zero,
+      ///        one worker per online processor core is used.
+      /// @returns True if all tests passed.
+      ///
+      bool run(int n_workers = 0);
+
+   private:
+
+      struct TestResult {
+         bool completed = false;
+         bool passed = false;
+         double duration = 0.0; // [s]
+      };
+
+      TestResult runTest(std::size_t test_id);
+
+      void runSequentially();
+      void runForked(int n_workers);
+
+      bool reportResults(double wall_time);
+
+   private:
+
+      Simulator &simulator_;
+
+      std::vector<std::string> test_names_;
+      std::vector<std::function<void()>> test_functions_;
+      std::vector<TestResult> results_;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
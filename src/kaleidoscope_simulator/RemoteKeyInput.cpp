@@ -0,0 +1,249 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/RemoteKeyInput.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace kaleidoscope {
+namespace simulator {
+   
+   RemoteKeyInput::RemoteKeyInput()
+   :  fd_(STDIN_FILENO)
+{
+   this->init(false /* serial device */);
+}
+
+   RemoteKeyInput::RemoteKeyInput(const char *path)
+{
+   struct stat file_status;
+   if(stat(path, &file_status) != 0) { return; }
+   
+   // Opening a FIFO for writing as well keeps a writer around. Otherwise,
+   // the input would end when the last writer closes the FIFO.
+   //
+   int access_mode = S_ISFIFO(file_status.st_mode) ? O_RDWR : O_RDONLY;
+   
+   fd_ = open(path, access_mode | O_NOCTTY | O_NONBLOCK);
+   owns_fd_ = true;
+   
+   this->init(true /* serial device */);
+}
+
+RemoteKeyInput::~RemoteKeyInput()
+{
+   if(epoll_fd_ >= 0) {
+      close(epoll_fd_);
+   }
+   
+   if(fd_ < 0) { return; }
+   
+   if(saved_terminal_settings_) {
+      auto settings = static_cast<struct termios*>(saved_terminal_settings_);
+      tcsetattr(fd_, TCSANOW, settings);
+      delete settings;
+   }
+   
+   if(owns_fd_) {
+      close(fd_);
+   }
+}
+
+void RemoteKeyInput::init(bool serial_device)
+{
+   if(fd_ < 0) { return; }
+   
+   // Serial devices and terminals deliver input byte by byte. Serial 
+   // devices are switched to raw mode. A terminal on stdin is usually 
+   // shared with stdout. Thus, we keep signal keys (Ctrl-C) and output 
+   // processing (newline translation) enabled.
+   //
+   if(isatty(fd_)) {
+      auto settings = new struct termios;
+      if(tcgetattr(fd_, settings) == 0) {
+         saved_terminal_settings_ = settings;
+         struct termios new_settings = *settings;
+         if(serial_device) {
+            cfmakeraw(&new_settings);
+         }
+         else {
+            new_settings.c_lflag &= ~(ICANON | ECHO);
+         }
+         new_settings.c_cc[VMIN] = 1;
+         new_settings.c_cc[VTIME] = 0;
+         tcsetattr(fd_, TCSANOW, &new_settings);
+      }
+      else {
+         delete settings;
+      }
+   }
+   
+#ifdef __linux__
+   // epoll does not support regular files. We use poll for those.
+   //
+   epoll_fd_ = epoll_create1(0);
+   if(epoll_fd_ >= 0) {
+      struct epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.fd = fd_;
+      if(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd_, &event) != 0) {
+         close(epoll_fd_);
+         epoll_fd_ = -1;
+      }
+   }
+#endif
+}
+
+bool RemoteKeyInput::wait(int timeout_ms)
+{
+#ifdef __linux__
+   if(epoll_fd_ >= 0) {
+      struct epoll_event event;
+      return epoll_wait(epoll_fd_, &event, 1, timeout_ms) > 0;
+   }
+#endif
+
+   struct pollfd poll_fd = {};
+   poll_fd.fd = fd_;
+   poll_fd.events = POLLIN;
+   return poll(&poll_fd, 1, timeout_ms) > 0;
+}
+
+void RemoteKeyInput::read()
+{
+   // Move the remainder of a record that was split across reads to 
+   // the front.
+   //
+   std::memmove(buffer_, buffer_ + buffer_begin_, buffer_end_ - buffer_begin_);
+   buffer_end_ -= buffer_begin_;
+   buffer_begin_ = 0;
+   
+   while(true) {
+      
+      auto n_bytes = ::read(fd_, buffer_ + buffer_end_, sizeof(buffer_) - buffer_end_);
+      
+      if(n_bytes < 0) {
+         if(errno == EINTR) { continue; }
+         if((errno != EAGAIN) && (errno != EWOULDBLOCK)) { at_end_ = true; }
+         return;
+      }
+      
+      if(n_bytes == 0) {
+         at_end_ = true;
+         return;
+      }
+      
+      buffer_end_ += n_bytes;
+      return;
+   }
+}
+
+bool RemoteKeyInput::waitForEvents(int timeout_ms,
+                                   KeyMatrixBitset &press,
+                                   KeyMatrixBitset &release,
+                                   KeyMatrixBitset &tap)
+{
+   if(!this->good()) { return false; }
+   
+   // We don't make stdin non-blocking, as it may share its file 
+   // description with stdout. Instead, we only read when input is 
+   // available. A read then returns without blocking.
+   //
+   if(buffer_end_ - buffer_begin_ < record_size) {
+      if(at_end_ || !this->wait(timeout_ms)) { return false; }
+      this->read();
+   }
+   
+   // The keys that changed state in this batch.
+   //
+   KeyMatrixBitset changed;
+   
+   bool events_read = false;
+   
+   while(buffer_end_ - buffer_begin_ >= record_size) {
+      
+      const uint8_t *record = buffer_ + buffer_begin_;
+      
+      uint8_t row = record[1];
+      uint8_t col = record[2];
+      
+      bool valid = (row < kaleidoscope::Device::KeyScanner::matrix_rows)
+                && (col < kaleidoscope::Device::KeyScanner::matrix_columns)
+                && (record[0] >= key_pressed) && (record[0] <= key_tapped);
+      
+      if(!valid) {
+         ++n_invalid_records_;
+         buffer_begin_ += record_size;
+         continue;
+      }
+      
+      auto key = SimulatorCore::keyIndex(row, col);
+      
+      // The key's next transition belongs to the next batch.
+      //
+      if(changed.test(key)) { break; }
+      
+      changed.set(key);
+      
+      switch(record[0]) {
+         case key_pressed:  press.set(key);   break;
+         case key_released: release.set(key); break;
+         case key_tapped:   tap.set(key);     break;
+      }
+      
+      buffer_begin_ += record_size;
+      events_read = true;
+   }
+   
+   return events_read;
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#else
+
+namespace kaleidoscope {
+namespace simulator {
+   
+RemoteKeyInput::RemoteKeyInput() {}
+RemoteKeyInput::RemoteKeyInput(const char *) {}
+RemoteKeyInput::~RemoteKeyInput() {}
+
+bool RemoteKeyInput::waitForEvents(int, KeyMatrixBitset &, KeyMatrixBitset &, KeyMatrixBitset &)
+{
+   return false;
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
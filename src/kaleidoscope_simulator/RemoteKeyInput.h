@@ -0,0 +1,148 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/SimulatorCore.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief Reads key events in a compact binary format from stdin,
+///        a serial device or a FIFO.
+/// @details Every key event is a record of three bytes: an opcode 
+///        (see Opcode), the key's row and the key's column.
+///        Records may be split across reads arbitrarily.
+///
+///        waitForEvents(...) waits for input to arrive via epoll, or poll
+///        where epoll is not available. It reads what is available with
+///        a single read and returns its key events as a batch.
+///        A batch ends before the first record of a key that already 
+///        changed state within the batch. Remaining records are kept 
+///        for the next batch. Thus, no key transition is lost, even if 
+///        input is read from a regular file that is always readable.
+///
+///        Serial devices are switched to raw mode, so that neither line
+///        buffering nor character translation delays or alters input.
+///        If stdin is a terminal, only line buffering and echo are
+///        disabled. As the terminal is usually shared with stdout, signal
+///        keys (e.g. Ctrl-C) and output processing remain enabled.
+///        FIFOs are opened for writing as well, so that the input does not 
+///        end when a writer closes the FIFO.
+///
+///        Input is only supported on unixoid systems.
+///
+class RemoteKeyInput
+{
+   public:
+      
+      /// @brief The opcodes of key event records.
+      ///
+      enum Opcode : uint8_t {
+         key_pressed  = 0x01,
+         key_released = 0x02,
+         key_tapped   = 0x03
+      };
+      
+      /// @brief The size of a key event record [bytes].
+      ///
+      static constexpr size_t record_size = 3;
+      
+      /// @brief Constructor. Reads from stdin.
+      ///
+      RemoteKeyInput();
+      
+      /// @brief Constructor. Reads from a file, e.g. a serial device or a FIFO.
+      /// @param path The path of the file.
+      ///
+      RemoteKeyInput(const char *path);
+      
+      /// @brief Destructor. Restores the terminal settings of the input
+      ///        and closes it if it was opened by the constructor.
+      ///
+      ~RemoteKeyInput();
+      
+      RemoteKeyInput(const RemoteKeyInput &) = delete;
+      RemoteKeyInput &operator=(const RemoteKeyInput &) = delete;
+      
+      /// @brief Checks if the input could be opened and has neither
+      ///        ended nor failed, or if key events remain to be returned.
+      ///
+      bool good() const { 
+         return (fd_ >= 0) 
+            && (!at_end_ || (buffer_end_ - buffer_begin_ >= record_size)); 
+      }
+      
+      /// @brief Waits for key events and returns a batch of them.
+      /// @details Every key changes state at most once per batch
+      ///        (see the class description).
+      ///        The bitsets are not cleared, new events are added.
+      /// @param timeout_ms The maximum time to wait [ms]. Zero does
+      ///        not wait, a negative value waits infinitely. There is no 
+      ///        wait if records remain from the previous batch.
+      /// @param press Receives the keys that were pressed.
+      /// @param release Receives the keys that were released.
+      /// @param tap Receives the keys that were tapped.
+      /// @returns True if any key event was read.
+      ///
+      bool waitForEvents(int timeout_ms,
+                         KeyMatrixBitset &press,
+                         KeyMatrixBitset &release,
+                         KeyMatrixBitset &tap);
+      
+      /// @brief The number of records with invalid opcode or key 
+      ///        position that were skipped.
+      ///
+      uint64_t getNumInvalidRecords() const { return n_invalid_records_; }
+      
+   private:
+      
+      void init(bool serial_device);
+      bool wait(int timeout_ms);
+      void read();
+      
+   private:
+      
+      int fd_ = -1;
+      bool owns_fd_ = false;
+      
+      // -1 if poll is used.
+      //
+      int epoll_fd_ = -1;
+      
+      // The saved terminal settings (struct termios) of terminals
+      // and serial devices.
+      //
+      void *saved_terminal_settings_ = nullptr;
+      
+      // Input that was read but not yet returned. Holds 
+      // the bytes buffer_[buffer_begin_] to buffer_[buffer_end_ - 1].
+      //
+      uint8_t buffer_[4096];
+      size_t buffer_begin_ = 0;
+      size_t buffer_end_ = 0;
+      
+      bool at_end_ = false;
+      uint64_t n_invalid_records_ = 0;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
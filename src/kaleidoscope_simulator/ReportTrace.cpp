@@ -0,0 +1,224 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/ReportTrace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+namespace kaleidoscope {
+namespace simulator {
+
+constexpr size_t ReportTraceRecord::max_data_size;
+
+namespace {
+
+const uint8_t trace_header[8] = { 'K', 'S', 'R', 'T', 1, 0, 0, 0 };
+
+// Cycle id, time and report id
+//
+constexpr size_t record_body_header_size = 9;
+
+void appendUInt32(std::vector<uint8_t> &buffer, uint32_t value)
+{
+   for(int i = 0; i < 4; ++i) {
+      buffer.push_back(static_cast<uint8_t>(value >> (8*i)));
+   }
+}
+
+#ifdef O_BINARY
+constexpr int o_binary = O_BINARY;
+#else
+constexpr int o_binary = 0;
+#endif
+
+// All existing writers, used by flushAll().
+//
+std::mutex writers_mutex;
+std::vector<ReportTraceWriter*> writers;
+
+uint32_t readUInt32(const uint8_t *bytes)
+{
+   return uint32_t(bytes[0])
+       | (uint32_t(bytes[1]) << 8)
+       | (uint32_t(bytes[2]) << 16)
+       | (uint32_t(bytes[3]) << 24);
+}
+
+} // namespace
+
+   ReportTraceWriter::ReportTraceWriter(const char *filename, size_t buffer_size)
+   :  filename_(filename),
+      fd_(::open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | o_binary, 0644)),
+      buffer_size_(buffer_size)
+{
+   buffer_.reserve(buffer_size_);
+
+   if(fd_ >= 0) {
+      buffer_.insert(buffer_.end(), trace_header, trace_header + sizeof(trace_header));
+   }
+   
+   std::lock_guard<std::mutex> lock{writers_mutex};
+   writers.push_back(this);
+}
+
+ReportTraceWriter::~ReportTraceWriter()
+{
+   {
+      std::lock_guard<std::mutex> lock{writers_mutex};
+      writers.erase(std::remove(writers.begin(), writers.end(), this), 
+                    writers.end());
+   }
+   
+   if(fd_ < 0) { return; }
+
+   this->flush();
+   ::close(fd_);
+}
+
+void ReportTraceWriter::write(uint32_t cycle_id, uint32_t time, uint8_t report_id,
+                              const void *data, size_t data_size)
+{
+   if(fd_ < 0) { return; }
+
+   data_size = std::min(data_size, ReportTraceRecord::max_data_size);
+
+   size_t body_size = record_body_header_size + data_size;
+
+   if(buffer_.size() + 2 + body_size > buffer_size_) {
+      this->flush();
+   }
+
+   buffer_.push_back(static_cast<uint8_t>(body_size));
+   buffer_.push_back(static_cast<uint8_t>(body_size >> 8));
+   appendUInt32(buffer_, cycle_id);
+   appendUInt32(buffer_, time);
+   buffer_.push_back(report_id);
+
+   const uint8_t *bytes = static_cast<const uint8_t*>(data);
+   buffer_.insert(buffer_.end(), bytes, bytes + data_size);
+
+   ++n_records_;
+}
+
+void ReportTraceWriter::flush()
+{
+   if((fd_ < 0) || buffer_.empty()) { return; }
+
+   // The buffer only contains complete records. It is appended with 
+   // a single write, so that processes that share the file after a 
+   // fork don't split each other's records. Only partial writes are
+   // continued.
+   //
+   const uint8_t *pos = buffer_.data();
+   size_t n_remaining = buffer_.size();
+
+   while(n_remaining > 0) {
+      auto n_written = ::write(fd_, pos, n_remaining);
+      if(n_written < 0) {
+         if(errno == EINTR) { continue; }
+         failed_ = true;
+         break;
+      }
+      pos += n_written;
+      n_remaining -= n_written;
+   }
+
+   buffer_.clear();
+}
+
+void ReportTraceWriter::flushAll()
+{
+   std::lock_guard<std::mutex> lock{writers_mutex};
+   for(auto writer: writers) {
+      writer->flush();
+   }
+}
+
+   ReportTraceReader::ReportTraceReader(const char *filename)
+   :  file_(std::fopen(filename, "rb"))
+{
+   if(!file_) { return; }
+
+   std::setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+
+   uint8_t header[sizeof(trace_header)];
+   if((std::fread(header, 1, sizeof(header), file_) != sizeof(header))
+         || (std::memcmp(header, trace_header, sizeof(header)) != 0)) {
+      failed_ = true;
+   }
+}
+
+ReportTraceReader::~ReportTraceReader()
+{
+   if(file_) {
+      std::fclose(file_);
+   }
+}
+
+bool ReportTraceReader::read(ReportTraceRecord &record)
+{
+   if(!this->good()) { return false; }
+
+   uint8_t length_bytes[2];
+   size_t n_read = std::fread(length_bytes, 1, 2, file_);
+
+   // Regular end of trace
+   //
+   if(n_read == 0) { return false; }
+
+   if(n_read != 2) {
+      failed_ = true;
+      return false;
+   }
+
+   size_t body_size = length_bytes[0] | (size_t(length_bytes[1]) << 8);
+
+   if((body_size < record_body_header_size)
+         || (body_size > record_body_header_size + ReportTraceRecord::max_data_size)) {
+      failed_ = true;
+      return false;
+   }
+
+   uint8_t body[record_body_header_size + ReportTraceRecord::max_data_size];
+   if(std::fread(body, 1, body_size, file_) != body_size) {
+      failed_ = true;
+      return false;
+   }
+
+   record.cycle_id = readUInt32(body);
+   record.time = readUInt32(body + 4);
+   record.report_id = body[8];
+   record.data_size = static_cast<uint8_t>(body_size - record_body_header_size);
+   std::memcpy(record.data, body + record_body_header_size, record.data_size);
+
+   return true;
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
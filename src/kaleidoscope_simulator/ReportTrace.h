@@ -0,0 +1,174 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief A HID report as stored in a report trace.
+///
+struct ReportTraceRecord {
+
+   /// @brief The maximum number of report data bytes.
+   ///
+   static constexpr size_t max_data_size = 64;
+
+   uint32_t cycle_id = 0;
+   uint32_t time = 0;       ///< Virtual time [ms]
+   uint8_t report_id = 0;   ///< The HID report id
+   uint8_t data_size = 0;
+   uint8_t data[max_data_size] = {};
+};
+
+/// @brief Writes HID reports to a binary trace file.
+/// @details A trace starts with an eight byte header (the magic
+///        string "KSRT", a version byte and three reserved bytes). Every
+///        report is stored as a record that consists of a two byte length
+///        of the record body followed by the body: the cycle id (4 bytes),
+///        the virtual time (4 bytes), the HID report id (1 byte) and
+///        the report data. All integers are little endian.
+///
+///        Two runs that produced identical reports produce byte-identical
+///        traces.
+///
+///        Records are collected in a memory buffer that is written to
+///        the file when it is full, on flush() and on destruction.
+///        Processes that terminate via _exit(...) do not destroy 
+///        the writer. Therefore, Simulator::checkpoint(), Simulator::restore(...)
+///        and ParallelTestRunner call flushAll() before forking and before
+///        terminating a process. The processes share the trace file.
+///        Every flush appends the buffered records to the file with 
+///        a single write. Thus, the records of different processes
+///        are never interleaved within a record. Records of checkpoint 
+///        passes are appended pass by pass, those of parallel test workers
+///        in the order the workers flush.
+///
+class ReportTraceWriter
+{
+   public:
+
+      /// @brief Constructor. Creates or truncates the trace file.
+      /// @param filename The name of the trace file.
+      /// @param buffer_size The size of the write buffer [bytes].
+      ///
+      ReportTraceWriter(const char *filename, size_t buffer_size = 1 << 16);
+
+      ~ReportTraceWriter();
+
+      ReportTraceWriter(const ReportTraceWriter &) = delete;
+      ReportTraceWriter &operator=(const ReportTraceWriter &) = delete;
+
+      /// @brief Checks if the trace file could be opened and all
+      ///        writes succeeded so far.
+      ///
+      bool good() const { return (fd_ >= 0) && !failed_; }
+
+      /// @brief Appends a report to the trace.
+      /// @param cycle_id The id of the cycle the report was generated in.
+      /// @param time The virtual time the report was generated at.
+      /// @param report_id The HID report id.
+      /// @param data The report data.
+      /// @param data_size The size of the report data. Data beyond
+      ///        ReportTraceRecord::max_data_size bytes is truncated.
+      ///
+      void write(uint32_t cycle_id, uint32_t time, uint8_t report_id,
+                 const void *data, size_t data_size);
+
+      /// @brief Writes all buffered records to the trace file.
+      ///
+      void flush();
+      
+      /// @brief Writes the buffered records of all existing 
+      ///        writers to their trace files.
+      ///
+      static void flushAll();
+
+      /// @brief The name of the trace file.
+      ///
+      const std::string &getFilename() const { return filename_; }
+
+      /// @brief The number of records written so far.
+      ///
+      uint64_t getNumRecords() const { return n_records_; }
+
+   private:
+
+      std::string filename_;
+      
+      // The trace file is opened for appending and written unbuffered.
+      //
+      int fd_ = -1;
+      std::vector<uint8_t> buffer_;
+      size_t buffer_size_;
+      uint64_t n_records_ = 0;
+      bool failed_ = false;
+};
+
+/// @brief Reads HID reports from a binary trace file
+///        written by ReportTraceWriter.
+///
+///        @code
+///        ReportTraceReader reader{"run.ksrt"};
+///        ReportTraceRecord record;
+///        while(reader.read(record)) {
+///           ...
+///        }
+///        if(!reader.good()) { /* not a trace or truncated */ }
+///        @endcode
+///
+class ReportTraceReader
+{
+   public:
+
+      /// @brief Constructor. Opens the trace file and checks its header.
+      /// @param filename The name of the trace file.
+      ///
+      ReportTraceReader(const char *filename);
+
+      ~ReportTraceReader();
+
+      ReportTraceReader(const ReportTraceReader &) = delete;
+      ReportTraceReader &operator=(const ReportTraceReader &) = delete;
+
+      /// @brief Checks if the trace could be opened, has a valid header
+      ///        and all records read so far were complete.
+      ///
+      bool good() const { return file_ && !failed_; }
+
+      /// @brief Reads the next record.
+      /// @param record The record to fill.
+      /// @returns True if a record was read, false at the end of the
+      ///        trace or on error (see good()).
+      ///
+      bool read(ReportTraceRecord &record);
+
+   private:
+
+      std::FILE *file_ = nullptr;
+      bool failed_ = false;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
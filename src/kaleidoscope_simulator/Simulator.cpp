@@ -18,36 +18,68 @@
 
 #include "kaleidoscope_simulator/Simulator.h"
 #include "kaleidoscope_simulator/SimulatorCore.h"
-#include "kaleidoscope_simulator/reports/KeyboardReport.h"
-#include "kaleidoscope_simulator/reports/BootKeyboardReport.h"
-#include "kaleidoscope_simulator/reports/MouseReport.h"
-#include "kaleidoscope_simulator/reports/AbsoluteMouseReport.h"
+#include "kaleidoscope_simulator/RemoteKeyInput.h"
+#include "kaleidoscope_simulator/ReportTrace.h"
+#include "kaleidoscope_simulator/reports/ReportTypes.h"
+#include "kaleidoscope_simulator/aux/logging.h"
+#include "kaleidoscope_simulator/aux/BackgroundThreads.h"
 
 #include "Kaleidoscope.h"
 #include "HIDReportObserver.h"
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KS_T_HAVE_FORK
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#endif
 
 namespace kaleidoscope {
 namespace simulator {
    
    Simulator::Simulator(std::ostream &out)
-   :  papilio::Simulator{out}
+   :  papilio::Simulator{out},
+      core_{new SimulatorCore{}}
 {
-   this->setCore(
-      std::shared_ptr<SimulatorCore>{
-                        new SimulatorCore{}
-      }
-   );
+   this->setCore(core_);
    
+   // The hook is shared by all simulators. It forwards reports 
+   // to the simulator that is active in the reporting thread.
+   //
    HIDReportObserver::resetHook(&Simulator::processHIDReport);
    
    Kaleidoscope.device().keyScanner().setEnableReadMatrix(false);
+   
+   this->activate();
+}
+
+Simulator::~Simulator()
+{
+   if(this->isActive()) {
+      active_simulator_ = nullptr;
+      core_->deactivate();
+   }
 }
 
+thread_local Simulator *Simulator::active_simulator_ = nullptr;
+
 Simulator &Simulator::getInstance() {
-   static Simulator sim{std::cout};
-   return sim;
+   if(!active_simulator_) {
+      static thread_local Simulator sim{std::cout};
+      sim.activate();
+   }
+   return *active_simulator_;
+}
+
+void Simulator::activate()
+{
+   active_simulator_ = this;
+   core_->activate();
 }
 
 void Simulator::processHIDReport(uint8_t id, const void* data, 
@@ -55,37 +87,289 @@ void Simulator::processHIDReport(uint8_t id, const void* data,
 {
    auto &simulator = Simulator::getInstance();
    
-   switch(id) {
-      // TODO: React appropriately on the following
-      //
-      case HID_REPORTID_GAMEPAD:
-      case HID_REPORTID_CONSUMERCONTROL:
-      case HID_REPORTID_SYSTEMCONTROL:
-         simulator.log() << "***Ignoring hid report with id = " << id;
-         break;
-      case HID_REPORTID_KEYBOARD:
-         {
-            simulator.processReport(BootKeyboardReport{data});
-         }
-         break;
-      case HID_REPORTID_MOUSE_ABSOLUTE:
-         {
-            simulator.processReport(AbsoluteMouseReport{data});
-         }
-         break;
-      case HID_REPORTID_MOUSE:
-         {
-            simulator.processReport(MouseReport{data});
+   simulator.core_->registerReport();
+   
+   KS_LOG(simulator, TRACE, "HID report with id = " << (int)id << ", length = " << len);
+   
+   // TODO: React appropriately on ignored report types
+   //
+   if(isIgnoredHIDReportType(id)) {
+      KS_LOG(simulator, INFO, "***Ignoring hid report with id = " << id);
+      return;
+   }
+   
+   bool known = visitReportType(id, [&simulator, data](auto tag) {
+      typedef typename decltype(tag)::Type ReportType;
+      simulator.processReport(ReportType{data});
+   });
+   
+   if(!known) {
+      simulator.error() << "Encountered unknown HID report with id = " << id;
+   }
+}
+
+void Simulator::applyKeyStates(const KeyMatrixBitset &press,
+                               const KeyMatrixBitset &release,
+                               const KeyMatrixBitset &tap)
+{
+   KS_LOG(*this, DEBUG, "Applying key states: " << press.count() << " pressed, "
+      << release.count() << " released, " << tap.count() << " tapped");
+      
+   core_->applyKeyStates(press, release, tap);
+}
+
+void Simulator::setIdleFastForward(bool state, 
+                                   uint32_t max_time_step,
+                                   int n_idle_cycles_required)
+{
+   idle_fast_forward_ = state;
+   max_idle_time_step_ = max_time_step;
+   n_idle_cycles_required_ = n_idle_cycles_required;
+   
+   core_->setIdleTracking(state);
+}
+
+bool Simulator::isIdle()
+{
+   return idle_fast_forward_
+      && (core_->getNumIdleCycles() >= n_idle_cycles_required_)
+      && !core_->isAnyKeyPressed()
+      && this->reportActionsQueue().empty()
+      && this->cycleActionsQueue().empty();
+}
+
+void Simulator::advanceTimeBy(uint32_t delta_t)
+{
+   this->advanceTimeTo(this->getTime() + delta_t);
+}
+
+void Simulator::advanceTimeTo(uint32_t time)
+{
+   if(!idle_fast_forward_) {
+      this->papilio::Simulator::advanceTimeTo(time);
+      return;
+   }
+   
+   while(this->getTime() < time) {
+      
+      uint32_t skip = 0;
+      
+      if(this->isIdle()) {
+         
+         // Jump ahead. The cycle that follows will notice
+         // if anything happens.
+         //
+         skip = std::min(max_idle_time_step_, time - this->getTime());
+         
+         uint32_t deadline;
+         if(next_idle_deadline_ && next_idle_deadline_(deadline)) {
+            skip = (deadline > this->getTime()) 
+                 ? std::min(skip, deadline - this->getTime()) : 0;
          }
-         break;
-      case HID_REPORTID_NKRO_KEYBOARD:
-         {
-            simulator.processReport(KeyboardReport{data});
+         
+         // Cycles run at the same points in time as without 
+         // fast-forwarding. The deadline is therefore noticed 
+         // by the same cycle.
+         //
+         if(cycle_time_step_ > 0) {
+            skip -= skip % cycle_time_step_;
          }
-         break;
-      default:
-         simulator.error() << "Encountered unknown HID report with id = " << id;
+         
+         this->setTime(this->getTime() + skip);
+      }
+      
+      auto cycle_start_time = this->getTime();
+      
+      this->cycle(true /*suppress cycle log info*/);
+      
+      cycle_time_step_ = this->getTime() - cycle_start_time;
+   }
+}
+
+void Simulator::runRemoteControlled(RemoteKeyInput &input,
+                                    std::function<void()> cycle_callback,
+                                    int max_wait_ms)
+{
+   auto wall_start_time = std::chrono::steady_clock::now();
+   auto start_time = this->getTime();
+   
+   while(input.good()) {
+      
+      KeyMatrixBitset press, release, tap;
+      
+      if(input.waitForEvents(max_wait_ms, press, release, tap)) {
+         this->applyKeyStates(press, release, tap);
+      }
+      
+      auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - wall_start_time).count();
+      
+      auto time = start_time + static_cast<uint32_t>(elapsed_ms);
+      
+      // Run at least one cycle to process new key events without delay.
+      //
+      if(time > this->getTime()) {
+         this->advanceTimeTo(time);
+      }
+      else {
+         this->cycle(true /*suppress cycle log info*/);
+      }
+      
+      if(cycle_callback) {
+         cycle_callback();
+      }
    }
+   
+   if(input.getNumInvalidRecords() > 0) {
+      this->error() << "Skipped " << input.getNumInvalidRecords()
+         << " invalid key event records";
+   }
+}
+
+#ifdef KS_T_HAVE_FORK
+
+namespace {
+   
+/// @private
+///
+struct RestoreRequest {
+   uint8_t failed;
+};
+
+// Flushes all output that would otherwise be lost by _exit(...) 
+// or written twice after fork().
+//
+void flushOutput()
+{
+   ReportTraceWriter::flushAll();
+   std::cout << std::flush;
+   std::cerr << std::flush;
+   std::fflush(stdout);
+   std::fflush(stderr);
+}
+
+} // namespace
+
+int Simulator::checkpoint()
+{
+   // The child process would lack the background thread, while
+   // output that it buffered would be written by both processes.
+   //
+   if(auto thread_name = getRunningBackgroundThread()) {
+      this->error() << "Unable to create a checkpoint while a " 
+         << thread_name << " is running";
+      return -1;
+   }
+   
+   Checkpoint cp;
+   
+   if(pipe(cp.request_fds) != 0) {
+      this->error() << "Failed to create checkpoint pipe";
+      return -1;
+   }
+   
+   fcntl(cp.request_fds[0], F_SETFL, O_NONBLOCK);
+   
+   cp.restore_count = 0;
+   cp.n_errors = this->getErrorCount();
+   
+   int checkpoint_id = static_cast<int>(checkpoints_.size());
+   checkpoints_.push_back(cp);
+   
+   bool failed = false;
+   
+   // The calling process becomes the keeper of the checkpoint. 
+   // It forks a new simulation process whenever the checkpoint is restored.
+   //
+   for(;;) {
+      
+      flushOutput();
+   
+      pid_t pid = fork();
+      
+      if(pid < 0) {
+         this->error() << "Failed to fork checkpoint process";
+         checkpoints_.pop_back();
+         return -1;
+      }
+      
+      if(pid == 0) {
+         // Simulation continues in the child process.
+         //
+         return checkpoint_id;
+      }
+      
+      int status = 0;
+      waitpid(pid, &status, 0);
+      
+      bool child_failed = !WIFEXITED(status) || (WEXITSTATUS(status) != 0);
+      
+      RestoreRequest request;
+      if(read(cp.request_fds[0], &request, sizeof(request)) != sizeof(request)) {
+         
+         // The simulation process terminated regularly.
+         //
+         flushOutput();
+         _exit((failed || child_failed) ? 1 : 0);
+      }
+      
+      failed = failed || request.failed || child_failed;
+      
+      ++checkpoints_[checkpoint_id].restore_count;
+   }
+}
+
+void Simulator::restore(int checkpoint_id)
+{
+   if((checkpoint_id < 0) 
+         || (checkpoint_id >= static_cast<int>(checkpoints_.size()))) {
+      this->error() << "Unable to restore unknown checkpoint " << checkpoint_id;
+      return;
+   }
+   
+   const auto &cp = checkpoints_[checkpoint_id];
+   
+   RestoreRequest request{
+      static_cast<uint8_t>(this->getErrorCount() != cp.n_errors)
+   };
+   
+   if(write(cp.request_fds[1], &request, sizeof(request)) != sizeof(request)) {
+      this->error() << "Failed to request restoring checkpoint " << checkpoint_id;
+      return;
+   }
+   
+   flushOutput();
+   
+   // Checkpoints created after the restored one are kept by
+   // intermediate processes that terminate as soon as 
+   // their simulation process terminates.
+   //
+   _exit(0);
+}
+
+#else
+
+int Simulator::checkpoint()
+{
+   this->error() << "Checkpoints are not supported on this platform";
+   return -1;
+}
+
+void Simulator::restore(int checkpoint_id)
+{
+   this->error() << "Checkpoints are not supported on this platform";
+}
+
+#endif
+
+int Simulator::getRestoreCount(int checkpoint_id) const
+{
+   if((checkpoint_id < 0) 
+         || (checkpoint_id >= static_cast<int>(checkpoints_.size()))) {
+      return 0;
+   }
+   
+   return checkpoints_[checkpoint_id].restore_count;
 }
 
 } // namespace simulator
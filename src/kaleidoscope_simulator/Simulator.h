@@ -19,6 +19,11 @@
 #pragma once
 
 #include "papilio/Simulator.h"
+#include "kaleidoscope_simulator/SimulatorCore.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
 
 /// @namespace kaleidoscope
 ///
@@ -28,22 +33,253 @@ namespace kaleidoscope {
 ///
 namespace simulator {
    
+class RemoteKeyInput;
+   
 /// @brief A Kaleidoscope specific simulator class.
+/// @details Every simulator owns its own simulator core, its own time
+///        and its own HID report handling. A simulator must be
+///        active (see activate()) in the thread that runs it. 
+///        Several simulators can be run in several threads. Please note,
+///        however, that the state of the firmware (Kaleidoscope, 
+///        the plugins, the virtual device) lives in global variables 
+///        that are defined by the firmware itself. Concurrent
+///        simulations therefore require the firmware's globals to be 
+///        thread-local.
 ///
 class Simulator : public papilio::Simulator
 {
    public:
       
-      /// @brief Access the global simulator singleton.
+      /// @brief Constructor.
+      /// @details The simulator becomes active in the calling thread.
+      /// @param out The stream that receives log output.
+      ///
+      Simulator(std::ostream &out);
+      
+      ~Simulator();
+      
+      Simulator(const Simulator &) = delete;
+      Simulator &operator=(const Simulator &) = delete;
+      
+      /// @brief Access the simulator that is active in the calling thread.
+      /// @details If no simulator was activated, a thread-specific default 
+      ///        simulator that logs to std::cout is created and activated.
       ///
       static Simulator &getInstance();
       
-   private:
+      /// @brief Makes this the simulator that is active in the calling thread.
+      /// @details The active simulator receives HID reports and
+      ///        provides the time that is returned by millis().
+      ///
+      void activate();
       
-      Simulator(std::ostream &out);
+      /// @brief Checks if this is the simulator that is active in the
+      ///        calling thread.
+      ///
+      bool isActive() const { return active_simulator_ == this; }
+      
+      /// @brief Enables or disables idle fast-forwarding.
+      /// @details While enabled, advanceTimeBy(...) and advanceTimeTo(...)
+      ///        jump the firmware clock ahead in large steps as long as 
+      ///        the firmware is idle (see isIdle()). As soon as a key
+      ///        is pressed, a report is generated, the LED state changes
+      ///        or actions are queued, the simulator falls back to
+      ///        stepping cycle by cycle.
+      ///        Please note that fast-forwarding changes the number of 
+      ///        scan cycles that are executed. Don't enable it for tests
+      ///        that make assertions about cycle counts.
+      ///        Timers that are internal to the firmware, e.g. the timeouts
+      ///        of OneShot or Qukeys or LED effects, are not visible to
+      ///        the simulator. Without a deadline function 
+      ///        (see setIdleFastForwardDeadline(...)), such a timeout can 
+      ///        expire up to max_time_step later than without
+      ///        fast-forwarding.
+      /// @param state The new fast-forward state.
+      /// @param max_time_step The maximum amount of time [ms] to skip
+      ///        in a single step.
+      /// @param n_idle_cycles_required The number of consecutive idle 
+      ///        cycles that must pass before fast-forwarding starts.
+      ///
+      void setIdleFastForward(bool state, 
+                              uint32_t max_time_step = 100,
+                              int n_idle_cycles_required = 10);
+      
+      /// @brief Sets a function that determines the next deadline 
+      ///        of the firmware.
+      /// @details Fast-forwarding never skips past the deadline. Time steps
+      ///        are multiples of the duration of a scan cycle. Thus, a 
+      ///        timeout expires in the same cycle and at the same time as 
+      ///        without fast-forwarding.
+      /// @param next_deadline A function that assigns the time [ms] of the
+      ///        next scheduled event, e.g. the expiration of a timeout, 
+      ///        and returns true. It returns false if no event is scheduled.
+      ///        Pass an empty function to remove a deadline function.
+      ///
+      void setIdleFastForwardDeadline(
+               const std::function<bool(uint32_t &deadline)> &next_deadline) {
+         next_idle_deadline_ = next_deadline;
+      }
+      
+      /// @brief Queries if idle fast-forwarding is enabled.
+      ///
+      bool getIdleFastForward() const { return idle_fast_forward_; }
+      
+      /// @brief Retreives the maximum time step used for fast-forwarding.
+      ///
+      uint32_t getIdleFastForwardTimeStep() const { return max_idle_time_step_; }
+      
+      /// @brief Checks if the firmware is idle.
+      /// @details The firmware is considered idle if no key is held,
+      ///        no report and no LED change occurred during the most recent 
+      ///        cycles and neither report nor cycle actions are queued.
+      /// @returns True if the firmware is idle.
+      ///
+      bool isIdle();
+      
+      /// @brief Advances time by a given amount.
+      /// @details Fast-forwards idle periods if enabled
+      ///        (see setIdleFastForward(...)).
+      /// @param delta_t The time interval [ms] to advance.
+      ///
+      void advanceTimeBy(uint32_t delta_t);
+      
+      /// @brief Advances time to a given point in time.
+      /// @details Fast-forwards idle periods if enabled
+      ///        (see setIdleFastForward(...)).
+      /// @param time The time [ms] to advance to.
+      ///
+      void advanceTimeTo(uint32_t time);
+      
+      /// @brief Changes the state of several keys at once.
+      /// @details This is considerably cheaper than calling pressKey(...),
+      ///        releaseKey(...) or tapKey(...) for every key.
+      ///        Use SimulatorCore::keyIndex(...) to determine a key's bit.
+      /// @param press The keys to press.
+      /// @param release The keys to release.
+      /// @param tap The keys to tap.
+      ///
+      void applyKeyStates(const KeyMatrixBitset &press,
+                          const KeyMatrixBitset &release = KeyMatrixBitset{},
+                          const KeyMatrixBitset &tap = KeyMatrixBitset{});
+      
+      /// @brief Retreives the keys that are currently pressed.
+      /// @returns A bitset with the bits of all pressed keys set.
+      ///
+      KeyMatrixBitset getMatrixState() const { return core_->getMatrixState(); }
+      
+      /// @brief Retreives the total number of HID reports that were 
+      ///        generated by the firmware.
+      ///
+      uint64_t getNumHIDReports() const { return core_->getNumReports(); }
+      
+      /// @brief Retreives a snapshot of the LED colors of all keys.
+      /// @details See SimulatorCore::getKeyLEDFramebuffer().
+      ///
+      const KeyLEDFramebuffer &getKeyLEDFramebuffer() const { 
+         return core_->getKeyLEDFramebuffer(); 
+      }
+      
+      /// @brief Retreives the LED generation.
+      /// @details See SimulatorCore::getLEDGeneration().
+      ///
+      uint32_t getLEDGeneration() const { return core_->getLEDGeneration(); }
+      
+      /// @brief Creates a checkpoint of the complete simulation state.
+      /// @details Checkpoints are copy-on-write snapshots of the simulator
+      ///        process. When a checkpoint is created, the current process
+      ///        stays behind, frozen in the checkpointed state, and the simulation
+      ///        continues in a child process. 
+      ///
+      ///        Similar to setjmp(...), checkpoint() returns again
+      ///        every time the checkpoint is restored. Use getRestoreCount(...)
+      ///        to distinguish the passes.
+      ///
+      /// @code
+      /// auto cp = simulator.checkpoint();
+      /// switch(simulator.getRestoreCount(cp)) {
+      ///    case 0:
+      ///       { auto test = simulator.newTest("A"); /* ... */ }
+      ///       simulator.restore(cp);
+      ///    case 1:
+      ///       { auto test = simulator.newTest("B"); /* ... */ }
+      ///       break;
+      /// }
+      /// @endcode
+      ///
+      ///        The exit status of the process reflects the errors of
+      ///        all passes. Checkpoints require fork() and are only supported
+      ///        on unixoid systems.
+      ///
+      ///        fork() only copies the calling thread. Therefore, no checkpoint
+      ///        can be created while an AsyncLogSink exists or a RenderThread 
+      ///        is running. Destroy the log sink, or stop the render thread, 
+      ///        before creating a checkpoint.
+      ///
+      /// @returns The checkpoint id or -1 if no checkpoint could be created.
+      ///
+      int checkpoint();
+      
+      /// @brief Restores a checkpoint.
+      /// @details The current simulation process terminates. Simulation 
+      ///        continues with a return from the checkpoint() call that 
+      ///        created the checkpoint.
+      /// @param checkpoint_id The id of the checkpoint to restore.
+      ///
+      void restore(int checkpoint_id);
+      
+      /// @brief Queries how often a checkpoint was restored.
+      /// @param checkpoint_id The id of the checkpoint.
+      /// @returns The number of times the checkpoint was restored
+      ///        to reach the current simulation process.
+      ///
+      int getRestoreCount(int checkpoint_id) const;
+      
+      using papilio::Simulator::runRemoteControlled;
+      
+      /// @brief Runs the simulation in real time, controlled by key events
+      ///        read from a RemoteKeyInput.
+      /// @details Between cycles, the simulator waits for input. Key events
+      ///        are applied as soon as they arrive. All key events that
+      ///        are available at once are applied as a single batch 
+      ///        (see applyKeyStates(...)). Simulation time follows
+      ///        the wall clock. Returns when the input ends.
+      /// @param input The key event input.
+      /// @param cycle_callback A function that is called after every cycle.
+      /// @param max_wait_ms The maximum wall clock time [ms] to wait for
+      ///        input before the next cycle runs.
+      ///
+      void runRemoteControlled(RemoteKeyInput &input,
+                               std::function<void()> cycle_callback 
+                                     = std::function<void()>{},
+                               int max_wait_ms = 1);
+      
+   private:
       
       static void processHIDReport(uint8_t id, const void* data, 
                                     int len, int result);
+      
+   private:
+      
+      static thread_local Simulator *active_simulator_;
+      
+      std::shared_ptr<SimulatorCore> core_;
+      
+      struct Checkpoint {
+         int request_fds[2];
+         int restore_count;
+         int n_errors;
+      };
+      
+      std::vector<Checkpoint> checkpoints_;
+      
+      bool idle_fast_forward_ = false;
+      uint32_t max_idle_time_step_ = 100;
+      int n_idle_cycles_required_ = 10;
+      std::function<bool(uint32_t &)> next_idle_deadline_;
+      
+      // The amount of time [ms] a scan cycle advances the time.
+      //
+      uint32_t cycle_time_step_ = 0;
 };
 
 } // namespace simulator
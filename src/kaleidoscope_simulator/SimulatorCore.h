@@ -19,15 +19,59 @@
 #pragma once
 
 #include "papilio/SimulatorCore_.h"
+#include "kaleidoscope_simulator/aux/Bitset.h"
+
+#include "Kaleidoscope.h"
+
+#include <array>
+
+// Undefine some macros defined by Arduino
+//
+#undef min
+#undef max
 
 namespace kaleidoscope {
 namespace simulator {
    
+/// @brief A bitset with one bit per key of the keyboard matrix.
+/// @details Use SimulatorCore::keyIndex(...) to determine the bit 
+///        that is associated with a key.
+///
+typedef Bitset<kaleidoscope::Device::KeyScanner::matrix_rows
+               *kaleidoscope::Device::KeyScanner::matrix_columns> KeyMatrixBitset;
+
+/// @brief The LED colors of all keys, packed as RGB triples.
+/// @details The color of a key is stored at byte offset 3*key_offset 
+///        with key_offset = row*matrix_columns + col (see SimulatorCore::keyIndex(...)).
+///        Keys without LED are black.
+///
+typedef std::array<uint8_t, 3*kaleidoscope::Device::KeyScanner::matrix_rows
+                             *kaleidoscope::Device::KeyScanner::matrix_columns> KeyLEDFramebuffer;
+   
 /// @brief A Kaleidoscope specific simulator core class.
+/// @details The core that is active in a thread provides the time
+///        that the firmware reads through millis().
 ///
 class SimulatorCore : public papilio::SimulatorCore_
 {
    public:
+      
+      /// @brief Makes this the core that is active in the calling thread.
+      ///
+      void activate();
+      
+      /// @brief Deactivates the core if it is active in the calling thread.
+      ///
+      void deactivate();
+      
+      /// @brief Retreives the core that is active in the calling thread.
+      /// @returns The active core or nullptr if none is active.
+      ///
+      static SimulatorCore *getActive() { return active_core_; }
+      
+      /// @brief Retreives the current firmware time [ms].
+      ///
+      uint32_t getTime() const { return time_; }
 
       virtual void init() override;
 
@@ -54,6 +98,95 @@ class SimulatorCore : public papilio::SimulatorCore_
       virtual const char *keycodeToName(uint8_t keycode) const override;
       
       virtual void loop() override;
+      
+      /// @brief Retreives the bit index of a key in a KeyMatrixBitset.
+      /// @param row The matrix row of the key.
+      /// @param col The matrix column of the key.
+      ///
+      static constexpr size_t keyIndex(uint8_t row, uint8_t col) {
+         return size_t(row)*kaleidoscope::Device::KeyScanner::matrix_columns + col;
+      }
+      
+      /// @brief Changes the state of several keys at once.
+      /// @details Keys that appear in more than one set are pressed first,
+      ///        then released, then tapped.
+      /// @param press The keys to press.
+      /// @param release The keys to release.
+      /// @param tap The keys to tap.
+      ///
+      void applyKeyStates(const KeyMatrixBitset &press,
+                          const KeyMatrixBitset &release,
+                          const KeyMatrixBitset &tap);
+      
+      /// @brief Retreives the keys that are currently pressed.
+      /// @returns A bitset with the bits of all pressed keys set.
+      ///
+      KeyMatrixBitset getMatrixState() const;
+      
+      /// @brief Checks if any key of the matrix is currently pressed.
+      ///
+      bool isAnyKeyPressed() const;
+      
+      /// @brief Retreives a snapshot of the LED colors of all keys.
+      /// @details The snapshot is taken at most once per scan cycle,
+      ///        when it is first requested after the cycle.
+      ///
+      const KeyLEDFramebuffer &getKeyLEDFramebuffer() const;
+      
+      /// @brief Copies the LED colors of all keys into a buffer.
+      /// @param rgb A buffer of at least sizeof(KeyLEDFramebuffer) bytes.
+      ///
+      void copyKeyLEDFramebuffer(uint8_t *rgb) const;
+      
+      /// @brief Retreives the LED generation.
+      /// @details The generation is incremented whenever a new snapshot 
+      ///        of the LED colors (see getKeyLEDFramebuffer()) differs from 
+      ///        the previous one. Renderers and assertions can 
+      ///        compare generations to skip work if the LEDs did not change.
+      ///
+      uint32_t getLEDGeneration() const;
+      
+      /// @brief Enables or disables tracking of idle cycles.
+      /// @details Idle tracking takes a snapshot of the LED state 
+      ///        after every cycle. It is therefore disabled by default.
+      ///
+      void setIdleTracking(bool state);
+      
+      /// @brief Retreives the number of consecutive cycles that passed 
+      ///        without any report being generated or any LED changing.
+      ///
+      int getNumIdleCycles() const { return n_idle_cycles_; }
+      
+      /// @brief Notifies the core about a HID report being generated.
+      ///
+      void registerReport() { report_in_cycle_ = true; ++n_reports_; }
+      
+      /// @brief Retreives the total number of HID reports that were 
+      ///        generated by the firmware.
+      ///
+      uint64_t getNumReports() const { return n_reports_; }
+      
+   private:
+      
+      void refreshKeyLEDFramebuffer() const;
+      
+   private:
+      
+      static thread_local SimulatorCore *active_core_;
+      
+      uint32_t time_ = 0;
+      
+      bool idle_tracking_ = false;
+      bool report_in_cycle_ = false;
+      int n_idle_cycles_ = 0;
+      uint32_t idle_led_generation_ = 0;
+      uint64_t n_reports_ = 0;
+      
+      uint64_t cycle_id_ = 0;
+      
+      mutable KeyLEDFramebuffer key_led_framebuffer_ = {};
+      mutable uint32_t led_generation_ = 0;
+      mutable uint64_t led_framebuffer_cycle_id_ = UINT64_MAX;
 };
 
 } // namespace simulator
@@ -0,0 +1,164 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __unix__ /* __unix__ is usually defined by compilers targeting Unix systems */
+
+#include "kaleidoscope_simulator/XTestHostEventBackend.h"
+#include "kaleidoscope_simulator/aux/keycodes.h"
+
+#include <X11/extensions/XTest.h>
+
+#include <cstdlib>
+
+// see /usr/include/linux/input-event-codes.h
+// and /usr/share/X11/xkb/keycodes/evdev
+// for information of Linux and X11 keycodes. The mapping from HID
+// keycodes to Linux keycodes is part of the keycode table (aux/keycodes.h).
+
+namespace kaleidoscope {
+namespace simulator {
+   
+namespace {
+// Maps HID keycodes to X11 keycodes. X11 keycodes are Linux input event 
+// codes shifted by 8. Returns 0 for keycodes without event code.
+//
+unsigned int toX11Keycode(uint8_t hid_keycode)
+{
+   auto evdev_code = getKeycodeInfo(hid_keycode).evdev_code;
+   return (evdev_code != 0) ? evdev_code + 8 : 0;
+}
+
+// X11 defines mouse buttons 4/5 as vertical scroll wheel up/down and 
+// buttons 6/7 as horizontal scroll wheel left/right actions. XTest 
+// has no multi-tick wheel event, one button press is sent per tick. 
+// Release events can be ignored.
+//
+void fakeWheelTicks(Display *d, int ticks, 
+                    unsigned int positive_button, unsigned int negative_button)
+{
+   auto button = (ticks > 0) ? positive_button : negative_button;
+   for(int i = std::abs(ticks); i > 0; --i) {
+      XTestFakeButtonEvent (d, button, True,  CurrentTime);
+   }
+}
+
+} // namespace
+   
+   XTestHostEventBackend::XTestHostEventBackend()
+   :  display_{XOpenDisplay(NULL)}
+{
+   auto d = static_cast<Display*>(display_);
+   
+   if(!d) { return; }
+   
+   XSelectInput(d, DefaultRootWindow(d), StructureNotifyMask);
+   screen_width_ = DisplayWidth(d, DefaultScreen(d));
+   screen_height_ = DisplayHeight(d, DefaultScreen(d));
+}
+
+XTestHostEventBackend::~XTestHostEventBackend()
+{
+   auto d = static_cast<Display*>(display_);
+   
+   if(!d) { return; }
+   
+   XSync(d, 0);
+   XCloseDisplay(d);
+}
+
+void XTestHostEventBackend::keyEvent(uint8_t hid_keycode, bool pressed)
+{
+   auto keycode = toX11Keycode(hid_keycode);
+   
+   if(!display_ || (keycode == 0)) { return; }
+   
+   XTestFakeKeyEvent(static_cast<Display*>(display_), keycode, pressed, CurrentTime);
+}
+
+void XTestHostEventBackend::buttonEvent(uint8_t button, bool pressed)
+{
+   if(!display_) { return; }
+   
+   XTestFakeButtonEvent(static_cast<Display*>(display_), button, pressed, CurrentTime);
+}
+
+void XTestHostEventBackend::relativeMotionEvent(int dx, int dy)
+{
+   if(!display_) { return; }
+   
+   XTestFakeRelativeMotionEvent(static_cast<Display*>(display_), dx, dy, CurrentTime);
+}
+
+void XTestHostEventBackend::absoluteMotionEvent(double x, double y)
+{
+   if(!display_) { return; }
+   
+   this->updateScreenSize();
+   
+   XTestFakeMotionEvent(static_cast<Display*>(display_), 0,
+                        int(screen_width_*x),
+                        int(screen_height_*y),
+                        CurrentTime);
+}
+
+void XTestHostEventBackend::wheelEvent(int vertical, int horizontal)
+{
+   if(!display_) { return; }
+   
+   auto d = static_cast<Display*>(display_);
+   
+   fakeWheelTicks(d, vertical, 4, 5);
+   fakeWheelTicks(d, horizontal, 6, 7);
+}
+
+void XTestHostEventBackend::flush()
+{
+   if(!display_) { return; }
+   
+   XFlush(static_cast<Display*>(display_));
+}
+
+void XTestHostEventBackend::sync()
+{
+   if(!display_) { return; }
+   
+   XSync(static_cast<Display*>(display_), 0);
+}
+
+void XTestHostEventBackend::updateScreenSize()
+{
+   auto d = static_cast<Display*>(display_);
+   
+   // Only reads events that already arrived, without a round trip 
+   // to the X server.
+   //
+   while(XEventsQueued(d, QueuedAfterReading) > 0) {
+      XEvent event;
+      XNextEvent(d, &event);
+      if((event.type == ConfigureNotify)
+            && (event.xconfigure.window == DefaultRootWindow(d))) {
+         screen_width_ = event.xconfigure.width;
+         screen_height_ = event.xconfigure.height;
+      }
+   }
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
+
+#endif
@@ -0,0 +1,82 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/HostEventBackend.h"
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief A host event backend that injects events into an X server
+///        via the XTest extension.
+/// @details The backend connects to the display named by the environment 
+///        variable DISPLAY. On headless systems, a virtual X server,
+///        e.g. Xvfb, can be used.
+///
+///        Events are buffered by Xlib until flush() or sync() is called.
+///
+class XTestHostEventBackend : public HostEventBackend
+{
+   public:
+      
+      /// @brief Constructor. Opens the display connection.
+      ///
+      XTestHostEventBackend();
+      
+      /// @brief Destructor. Sends all queued events and closes
+      ///        the display connection.
+      ///
+      ~XTestHostEventBackend();
+      
+      XTestHostEventBackend(const XTestHostEventBackend &) = delete;
+      XTestHostEventBackend &operator=(const XTestHostEventBackend &) = delete;
+      
+      /// @brief Checks if the display connection could be opened. 
+      /// @details Without a connection, all events are ignored.
+      ///
+      bool good() const { return display_ != nullptr; }
+      
+      virtual void keyEvent(uint8_t hid_keycode, bool pressed) override;
+      virtual void buttonEvent(uint8_t button, bool pressed) override;
+      virtual void relativeMotionEvent(int dx, int dy) override;
+      virtual void absoluteMotionEvent(double x, double y) override;
+      virtual void wheelEvent(int vertical, int horizontal) override;
+      virtual void flush() override;
+      virtual void sync() override;
+      
+   private:
+      
+      void updateScreenSize();
+      
+   private:
+      
+      // The X display connection (Display*).
+      //
+      void *display_ = nullptr;
+      
+      // Cached screen size [pixels]. Listening to structure notifications
+      // of the root window, we receive a ConfigureNotify event when 
+      // the screen is resized, e.g. by RandR.
+      //
+      int screen_width_ = 0;
+      int screen_height_ = 0;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,119 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/reports/KeyboardReport.h"
+#include "kaleidoscope_simulator/aux/keycodes.h"
+
+#include "papilio/actions/generic_report/ReportAction.h"
+
+namespace kaleidoscope {
+namespace simulator {
+namespace actions {
+
+/// @brief Asserts that a set of keycodes is active in a keyboard report.
+/// @details The check is a single subset test on the report's keycode
+///        bitset, no matter how many keys are passed. Modifier keys
+///        are checked as well.
+///
+///        @code
+///        simulator.cycleExpectReports(AssertKeycodeSetActive{Key_A, Key_B, Key_LeftShift});
+///        simulator.cycleExpectReports(AssertKeycodeSetActive{Key_A}.exclusively());
+///        @endcode
+///
+class AssertKeycodeSetActive {
+
+   public:
+
+      /// @brief Constructor.
+      /// @param key A key whose keycode must be active for the action to pass.
+      /// @param keys Further keys whose keycodes must be active.
+      ///
+      template<typename..._Keys>
+      AssertKeycodeSetActive(Key key, _Keys... keys)
+         : AssertKeycodeSetActive(DelegateConstruction{}, toKeycodeBitset(key, keys...))
+      {}
+
+      /// @brief Requires that no other keycodes are active.
+      ///
+      AssertKeycodeSetActive &exclusively() {
+         action_->exclusive_ = true;
+         return *this;
+      }
+
+   private:
+
+      static KeycodeBitset toKeycodeBitset() { return KeycodeBitset{}; }
+
+      template<typename..._Keys>
+      static KeycodeBitset toKeycodeBitset(Key key, _Keys... keys) {
+         KeycodeBitset keycodes = toKeycodeBitset(keys...);
+         keycodes.set(key.getKeyCode());
+         return keycodes;
+      }
+
+      class Action : public papilio::ReportAction<papilio::KeyboardReport_> {
+
+         public:
+
+            Action(const KeycodeBitset &keycodes) : keycodes_(keycodes) {}
+
+            virtual void describe(const char *add_indent = "") const override {
+               auto out = this->getSimulator()->log();
+               out << add_indent << "Keycodes ";
+               keycodes_.forEach([&out](size_t k) {
+                  out << getKeycodeInfo(static_cast<uint8_t>(k)).name << " ";
+               });
+               out << (exclusive_ ? "exclusively " : "") << "expected to be active";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               auto out = this->getSimulator()->log();
+               out << add_indent << "Active keycodes ";
+               this->getKeyboardReport().forEachActiveKeycode([&out](uint8_t k) {
+                  out << getKeycodeInfo(k).name << " ";
+               });
+            }
+
+            virtual bool evalInternal() override {
+               const auto &report = this->getKeyboardReport();
+               return exclusive_ ? report.areExactlyKeycodesActive(keycodes_)
+                                 : report.areKeycodesActive(keycodes_);
+            }
+
+         private:
+
+            const KeyboardReport &getKeyboardReport() const {
+               return static_cast<const KeyboardReport&>(this->getReport());
+            }
+
+         private:
+
+            friend class AssertKeycodeSetActive;
+
+            KeycodeBitset keycodes_;
+            bool exclusive_ = false;
+      };
+
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertKeycodeSetActive)
+};
+
+} // namespace actions
+} // namespace simulator
+} // namespace kaleidoscope
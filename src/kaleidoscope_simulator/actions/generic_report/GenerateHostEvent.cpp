@@ -20,235 +20,256 @@
 #include "kaleidoscope_simulator/reports/KeyboardReport.h"
 #include "kaleidoscope_simulator/reports/MouseReport.h"
 #include "kaleidoscope_simulator/reports/AbsoluteMouseReport.h"
+#include "kaleidoscope_simulator/aux/KeycodeDelta.h"
 #include "papilio/Simulator.h"
 
-#ifdef __unix__ /* __unix__ is usually defined by compilers targeting Unix systems */
-
-#include <X11/extensions/XTest.h>
-#include <unistd.h>
-#include <linux/input-event-codes.h>
-
-#include <set>
-
-// see /usr/include/linux/input-event-codes.h
-// and /usr/share/X11/xkb/keycodes/evdev
-// for information of Linux and X11 keycodes 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
 
 namespace kaleidoscope {
 namespace simulator {
 namespace actions {
    
+/// @private
+///
+struct SharedHostEventBackend
+{
+   std::shared_ptr<HostEventBackend> backend;
+   
+   // The wheel movement that was not sent yet [ticks].
+   //
+   int pending_vertical_wheel = 0;
+   int pending_horizontal_wheel = 0;
+};
+   
+namespace {
+
+HostEventAction::FlushPolicy flush_policy 
+   = HostEventAction::FlushPolicy::sync_each_report;
+std::chrono::milliseconds flush_interval{10};
+std::chrono::steady_clock::time_point last_flush_time;
+
+// All existing host event actions, used by flushAll(). The mutex
+// also guards the backends.
+//
+std::mutex host_event_actions_mutex;
+std::vector<HostEventAction*> host_event_actions;
+
+// The backend set by the user. 
+//
+std::shared_ptr<SharedHostEventBackend> user_backend;
+
+// The default backend is shared by all actions. It is created by 
+// the first and destroyed with the last action that uses it.
+//
+std::weak_ptr<SharedHostEventBackend> default_backend;
+
+std::shared_ptr<SharedHostEventBackend> acquireBackend()
+{
+   if(user_backend) { return user_backend; }
+   
+   auto backend = default_backend.lock();
+   
+   if(!backend) {
+      backend = std::make_shared<SharedHostEventBackend>();
+      backend->backend = createDefaultHostEventBackend();
+      default_backend = backend;
+   }
+   
+   return backend;
+}
+
+// Checks if two wheel movements point in opposite directions.
+//
+bool opposite(int movement, int other_movement)
+{
+   return (movement > 0 && other_movement < 0) 
+       || (movement < 0 && other_movement > 0);
+}
+
+} // namespace
+   
    HostEventAction::HostEventAction()
-      :  display_{XOpenDisplay(NULL)}
 {
+   std::lock_guard<std::mutex> lock{host_event_actions_mutex};
+   shared_backend_ = acquireBackend();
+   backend_ = shared_backend_->backend;
+   host_event_actions.push_back(this);
 }   
 
    HostEventAction::~HostEventAction()
 {
-   auto d = static_cast<Display*>(display_);
-   XSync(d, 0);
-   XCloseDisplay(d);
+   std::lock_guard<std::mutex> lock{host_event_actions_mutex};
+   
+   host_event_actions.erase(
+      std::remove(host_event_actions.begin(), host_event_actions.end(), this),
+      host_event_actions.end());
+   
+   this->flush();
+   
+   // Destroys the default backend if this is the last action using it.
+   //
+   backend_.reset();
+   shared_backend_.reset();
 }
+
+void HostEventAction::setFlushPolicy(FlushPolicy policy, uint32_t interval_ms)
+{
+   flushAll();
    
-namespace {
-unsigned const int modifiers[] = {
-   KEY_LEFTCTRL, KEY_LEFTSHIFT, KEY_LEFTALT, KEY_LEFTMETA,
-      KEY_RIGHTCTRL, KEY_RIGHTSHIFT, KEY_RIGHTALT, KEY_RIGHTMETA 
-};
+   flush_policy = policy;
+   flush_interval = std::chrono::milliseconds{interval_ms};
+   last_flush_time = std::chrono::steady_clock::now();
+}
+
+void HostEventAction::flushAll()
+{
+   std::lock_guard<std::mutex> lock{host_event_actions_mutex};
+   for(auto action: host_event_actions) {
+      action->flush();
+   }
+   last_flush_time = std::chrono::steady_clock::now();
+}
+
+void HostEventAction::setBackend(const std::shared_ptr<HostEventBackend> &backend)
+{
+   std::lock_guard<std::mutex> lock{host_event_actions_mutex};
    
-unsigned const int keycodes[][8] = {
-   { 0, 0, 0, 0, KEY_A, KEY_B, KEY_C, KEY_D },
-   { KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L },
-   { KEY_M, KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T },
-   { KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z, KEY_1, KEY_2 },
-   { KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9, KEY_0 },
-   { KEY_ENTER, KEY_ESC, KEY_BACKSPACE, KEY_TAB, KEY_SPACE, KEY_MINUS, KEY_EQUAL, KEY_LEFTBRACE },
-   { KEY_RIGHTBRACE, KEY_BACKSLASH, KEY_BACKSLASH, KEY_SEMICOLON, KEY_APOSTROPHE, KEY_GRAVE, KEY_COMMA, KEY_DOT },
-   { KEY_SLASH, KEY_CAPSLOCK, KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6 },
-   { KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12, KEY_SYSRQ, KEY_SCROLLLOCK },
-   { KEY_PAUSE, KEY_INSERT, KEY_HOME, KEY_PAGEUP, KEY_DELETE, KEY_END, KEY_PAGEDOWN, KEY_RIGHT },
-   { KEY_LEFT, KEY_DOWN, KEY_UP, KEY_NUMLOCK, KEY_KPSLASH, KEY_KPASTERISK, KEY_KPMINUS, KEY_KPPLUS },
-   { KEY_KPENTER, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4, KEY_KP5, KEY_KP6, KEY_KP7 },
-   { KEY_KP8, KEY_KP9, KEY_KP0, KEY_KPDOT, KEY_SLASH, KEY_APPSELECT, KEY_POWER, KEY_KPEQUAL },
-   { KEY_F13, KEY_F14, KEY_F15, KEY_F16, KEY_F17, KEY_F18, KEY_F19, KEY_F20 },
-   { KEY_F21, KEY_F22, KEY_F23, KEY_F24, KEY_OPEN, KEY_HELP, KEY_MENU, KEY_SELECT },
-   { KEY_STOP, KEY_AGAIN, KEY_UNDO, KEY_CUT, KEY_COPY, KEY_PASTE, KEY_FIND, KEY_MUTE },
-   { KEY_VOLUMEUP, KEY_VOLUMEDOWN, KEY_UNKNOWN, KEY_UNKNOWN, KEY_UNKNOWN, KEY_UNKNOWN, KEY_UNKNOWN, KEY_UNKNOWN }
-};
+   if(!backend) {
+      user_backend.reset();
+      return;
+   }
+   
+   user_backend = std::make_shared<SharedHostEventBackend>();
+   user_backend->backend = backend;
+}
 
-class KeyboardReportEventCheck {
+void HostEventAction::addWheelMovement(int vertical, int horizontal)
+{
+   auto &shared_backend = *shared_backend_;
    
-   public:
-      
-      KeyboardReportEventCheck(const papilio::Simulator &simulator,
-                    Display *display,
-                    const KeyboardReport &previous_report, 
-                    const KeyboardReport &current_report)
-      :  simulator_{simulator},
-         display_{display},
-         previous_report_data_{previous_report.getReportData()},
-         current_report_data_{current_report.getReportData()}
-      {}
-      
-      void compareReports() {
-            
-         for(int j = 0; j < 8; ++j) {
-            this->modifierCheck(j);
-         }
-         
-         for(int i = 0; i < 17; ++i) {
-            for(int j = 0; j < 8; ++j) {
-               this->keyCheck(i, j);
-            }
-         }
-      }
-      
-   private:
-      
-      void modifierCheck(int j)
-      {   
-         auto old_state = bitRead(previous_report_data_.modifiers, j);
-         auto new_state = bitRead(current_report_data_.modifiers, j);
-         
-         if(old_state == new_state) { return; }
-         
-         auto keycode = modifiers[j] + 8;
-         
-         bool is_pressed = (new_state) ? true : false;
-         
-         XTestFakeKeyEvent(display_, keycode, is_pressed, CurrentTime);
-      }
-      
-      void keyCheck(int i, int j)
-      {   
-         auto old_state = bitRead(previous_report_data_.keys[i], j);
-         auto new_state = bitRead(current_report_data_.keys[i], j);
-         
-         if(old_state == new_state) { return; }
-         
-         auto keycode = keycodes[i][j] + 8;
-         
-         bool is_pressed = (new_state) ? true : false;
-         
-         //simulator_.debug() << "Generating system keycode " << keycode << " (pressed = " << is_pressed << ")";
-         XTestFakeKeyEvent(display_, keycode, is_pressed, CurrentTime);
-      }
-      
-   private:
-      
-      const papilio::Simulator &simulator_;
-      Display *display_;
-      const KeyboardReport::ReportDataType &previous_report_data_;
-      const KeyboardReport::ReportDataType &current_report_data_;
-};
+   // Only movements in the same direction are coalesced. Opposite 
+   // movements must both reach the host.
+   //
+   if(opposite(vertical, shared_backend.pending_vertical_wheel)
+         || opposite(horizontal, shared_backend.pending_horizontal_wheel)) {
+      this->sendPendingWheelMovement();
+   }
+   
+   shared_backend.pending_vertical_wheel += vertical;
+   shared_backend.pending_horizontal_wheel += horizontal;
+}
 
-class BootKeyboardReportEventCheck {
+void HostEventAction::sendPendingWheelMovement()
+{
+   auto &shared_backend = *shared_backend_;
    
-   public:
-      
-      BootKeyboardReportEventCheck(const papilio::Simulator &simulator,
-                    Display *display,
-                    const BootKeyboardReport &previous_report, 
-                    const BootKeyboardReport &current_report)
-      :  simulator_{simulator},
-         display_{display},
-         previous_report_data_{previous_report.getReportData()},
-         current_report_data_{current_report.getReportData()}
-      {
-      }
-      
-      void compareReports() {
-            
-         for(int j = 0; j < 8; ++j) {
-            this->modifierCheck(j);
-         }
-         
-         this->keyCheck();
-      }
-      
-   private:
-      
-      void modifierCheck(int j)
-      {   
-         auto old_state = bitRead(previous_report_data_.modifiers, j);
-         auto new_state = bitRead(current_report_data_.modifiers, j);
-         
-         if(old_state == new_state) { return; }
-         
-         auto keycode = modifiers[j] + 8;
-         
-         bool is_pressed = (new_state) ? true : false;
-         
-         XTestFakeKeyEvent(display_, keycode, is_pressed, CurrentTime);
-      }
-      
-      void keyCheck()
-      {   
-         std::set<uint8_t> previous_report_keycodes,
-                           current_report_keycodes;
-      
-         for(int i = 0; i < 6; ++i) {
-            if(previous_report_data_.keycodes[i] != 0) {
-               previous_report_keycodes.insert(
-                  previous_report_data_.keycodes[i]
-               );
-            }
-            if(current_report_data_.keycodes[i] != 0) {
-               current_report_keycodes.insert(
-                  current_report_data_.keycodes[i]
-               );
-            }
-         }
-         
-         for(const auto &k: previous_report_keycodes) {
-            if(current_report_keycodes.find(k) == current_report_keycodes.end()) {
-               
-               auto actual_keycode = getActualKeycode(k);
-               
-               // Keycode only present in previous report 
-               // => key released
-               XTestFakeKeyEvent(display_, actual_keycode, False, CurrentTime);
-            }
-         }
-         for(const auto &k: current_report_keycodes) {
-            if(previous_report_keycodes.find(k) == previous_report_keycodes.end()) {
-               
-               auto actual_keycode = getActualKeycode(k);
-               
-               // Keycode only present in current report 
-               // => key pressed
-               XTestFakeKeyEvent(display_, actual_keycode, True, CurrentTime);
-            }
+   if((shared_backend.pending_vertical_wheel == 0) 
+         && (shared_backend.pending_horizontal_wheel == 0)) {
+      return;
+   }
+   
+   backend_->wheelEvent(shared_backend.pending_vertical_wheel, 
+                        shared_backend.pending_horizontal_wheel);
+   
+   shared_backend.pending_vertical_wheel = 0;
+   shared_backend.pending_horizontal_wheel = 0;
+}
+
+void HostEventAction::reportProcessed()
+{
+   events_pending_ = true;
+   
+   switch(flush_policy) {
+      case FlushPolicy::sync_each_report:
+         this->flush();
+         backend_->sync();
+         break;
+      case FlushPolicy::flush_each_report:
+         this->flush();
+         break;
+      case FlushPolicy::interval:
+         if(std::chrono::steady_clock::now() - last_flush_time >= flush_interval) {
+            flushAll();
          }
-      }
-      
-      static uint8_t getActualKeycode(uint8_t k) {
-         return keycodes[k/8][k%8] + 8;
-      }
-      
-   private:
-      
-      const papilio::Simulator &simulator_;
-      Display *display_;
-      const BootKeyboardReport::ReportDataType &previous_report_data_;
-      const BootKeyboardReport::ReportDataType &current_report_data_;
-};
+         break;
+      case FlushPolicy::explicit_only:
+         break;
+   }
+}
+
+void HostEventAction::flush()
+{
+   if(!events_pending_) { return; }
+   
+   this->sendPendingWheelMovement();
+   
+   events_pending_ = false;
+   
+   backend_->flush();
+}
+   
+namespace {
+
+// Generates key events for all keycodes that were pressed or 
+// released between two keyboard reports.
+//
+template<typename _ReportType>
+void generateKeyEvents(HostEventBackend &backend,
+                       const _ReportType &previous_report, 
+                       const _ReportType &current_report)
+{
+   KeycodeDelta{
+      previous_report.getActiveKeycodeBitset(),
+      current_report.getActiveKeycodeBitset()
+   }.forEachTransition([&backend](uint8_t keycode, bool pressed) {
+      backend.keyEvent(keycode, pressed);
+   });
+}
+
+template<typename _ReportType>
+bool buttonsChanged(const _ReportType &previous_report, 
+                    const _ReportType &current_report)
+{
+   return (previous_report.isLeftButtonPressed() != current_report.isLeftButtonPressed())
+       || (previous_report.isMiddleButtonPressed() != current_report.isMiddleButtonPressed())
+       || (previous_report.isRightButtonPressed() != current_report.isRightButtonPressed());
+}
+
+// Generates button events for all mouse buttons that changed state 
+// between two mouse reports.
+//
+template<typename _ReportType>
+void generateButtonEvents(HostEventBackend &backend,
+                          const _ReportType &previous_report, 
+                          const _ReportType &current_report)
+{
+   if(previous_report.isLeftButtonPressed() != current_report.isLeftButtonPressed()) {
+      backend.buttonEvent(1, current_report.isLeftButtonPressed());
+   }
+   if(previous_report.isMiddleButtonPressed() != current_report.isMiddleButtonPressed()) {
+      backend.buttonEvent(2, current_report.isMiddleButtonPressed());
+   }
+   if(previous_report.isRightButtonPressed() != current_report.isRightButtonPressed()) {
+      backend.buttonEvent(3, current_report.isRightButtonPressed());
+   }
+}
 
 } // namespace
 
 template<>
 bool GenerateHostEvent<BootKeyboardReport>::Action::evalInternal()
 {
-   auto d = static_cast<Display*>(display_);
+   this->sendPendingWheelMovement();
    
-   BootKeyboardReportEventCheck{
-      *this->getSimulator(),
-      d,
-      *previous_report_, 
-      static_cast<const BootKeyboardReport&>(this->getReport())
-   }.compareReports();
+   generateKeyEvents(
+      *backend_,
+      previous_report_, 
+      static_cast<const BootKeyboardReport&>(this->getReport()));
    
-   XSync(d, 0);
+   this->reportProcessed();
    
    this->cachePreviousReport();
 
@@ -261,16 +282,14 @@ bool GenerateHostEvent<BootKeyboardReport>::Action::evalInternal()
 template<>
 bool GenerateHostEvent<KeyboardReport>::Action::evalInternal()
 {
-   auto d = static_cast<Display*>(display_);
+   this->sendPendingWheelMovement();
    
-   KeyboardReportEventCheck{
-      *this->getSimulator(),
-      d,
-      *previous_report_, 
-      static_cast<const KeyboardReport&>(this->getReport())
-   }.compareReports();
+   generateKeyEvents(
+      *backend_,
+      previous_report_, 
+      static_cast<const KeyboardReport&>(this->getReport()));
    
-   XSync(d, 0);
+   this->reportProcessed();
    
    this->cachePreviousReport();
 
@@ -283,52 +302,30 @@ bool GenerateHostEvent<KeyboardReport>::Action::evalInternal()
 template<>
 bool GenerateHostEvent<MouseReport>::Action::evalInternal()
 {
-   const auto &report = this->getReport();
-   
-   auto d = static_cast<Display*>(display_);
-   
-   XTestFakeRelativeMotionEvent (d,
-                  report.getXMovement(),
-                  report.getYMovement(),
-                  CurrentTime);
+   const auto &report = static_cast<const MouseReport&>(this->getReport());
    
-   XTestFakeButtonEvent (d, 1, report.isLeftButtonPressed(),  CurrentTime);
-   XTestFakeButtonEvent (d, 2, report.isMiddleButtonPressed(),  CurrentTime);
-   XTestFakeButtonEvent (d, 3, report.isRightButtonPressed(),  CurrentTime);
+   bool motion = (report.getXMovement() != 0) || (report.getYMovement() != 0);
    
-   auto v_wheel = report.getVerticalWheel();
-   auto h_wheel = report.getHorizontalWheel();
-   
-   // X11 defines mouse button 4 as vertical scroll wheel up action and mouse
-   // button 5 as vertical scroll wheel down action.
+   // Reports that only move the wheel don't interrupt a run of 
+   // wheel movements.
    //
-   if(v_wheel > 0) {
-      for(int i = 0; i < v_wheel; ++i) {
-         XTestFakeButtonEvent (d, 4, True,  CurrentTime);
-         // Release events can be ignored
-      }
-   }
-   else if(v_wheel < 0) {
-      for(int i = 0; i > v_wheel; --i) {
-         XTestFakeButtonEvent (d, 5, True,  CurrentTime);
+   if(motion || buttonsChanged(previous_report_, report)) {
+      
+      this->sendPendingWheelMovement();
+      
+      if(motion) {
+         backend_->relativeMotionEvent(report.getXMovement(), report.getYMovement());
       }
-   }
    
-   // X11 defines mouse button 6 as horizontal scroll wheel left action and mouse
-   // button 7 as horizontal scroll wheel down action.
-   //
-   if(h_wheel > 0) {
-      for(int i = 0; i < h_wheel; ++i) {
-         XTestFakeButtonEvent (d, 6, True,  CurrentTime);
-      }
-   }
-   else if(h_wheel < 0) {
-      for(int i = 0; i > h_wheel; --i) {
-         XTestFakeButtonEvent (d, 7, True,  CurrentTime);
-      }
+      generateButtonEvents(*backend_, previous_report_, report);
    }
+   
+   this->addWheelMovement(report.getVerticalWheel(), 
+                          report.getHorizontalWheel());
          
-   XSync(d, 0);
+   this->reportProcessed();
+   
+   this->cachePreviousReport();
    
    return true;
 }
@@ -336,59 +333,32 @@ bool GenerateHostEvent<MouseReport>::Action::evalInternal()
 template<>
 bool GenerateHostEvent<AbsoluteMouseReport>::Action::evalInternal()
 {
-   const auto &report = this->getReport();
-   
-   auto d = static_cast<Display*>(display_);
-   
-   auto x_pos = DisplayWidth(d, 0)*report.getXPosition()
-                  / AbsoluteMouseReport::max_x_coordinate;
-   auto y_pos = DisplayHeight(d, 0)*report.getYPosition()
-                  / AbsoluteMouseReport::max_y_coordinate;
-   
-   XTestFakeMotionEvent (d, 0, 
-                  x_pos,
-                  y_pos,
-                  CurrentTime);
+   const auto &report = static_cast<const AbsoluteMouseReport&>(this->getReport());
    
-   XTestFakeButtonEvent (d, 1, report.isLeftButtonPressed(),  CurrentTime);
-   XTestFakeButtonEvent (d, 2, report.isMiddleButtonPressed(),  CurrentTime);
-   XTestFakeButtonEvent (d, 3, report.isRightButtonPressed(),  CurrentTime);
+   bool motion = !previous_report_valid_
+              || (report.getXPosition() != previous_report_.getXPosition())
+              || (report.getYPosition() != previous_report_.getYPosition());
    
-   auto v_wheel = report.getVerticalWheel();
-   //auto h_wheel = report.getHorizontalWheel();
+   if(motion || buttonsChanged(previous_report_, report)) {
+      
+      this->sendPendingWheelMovement();
    
-   // X11 defines mouse button 4 as vertical scroll wheel up action and mouse
-   // button 5 as vertical scroll wheel down action.
-   //
-   if(v_wheel > 0) {
-      for(int i = 0; i < v_wheel; ++i) {
-         XTestFakeButtonEvent (d, 4, True,  CurrentTime);
-         // Release events can be ignored
-      }
-   }
-   else if(v_wheel < 0) {
-      for(int i = 0; i > v_wheel; --i) {
-         XTestFakeButtonEvent (d, 5, True,  CurrentTime);
+      if(motion) {
+         backend_->absoluteMotionEvent(
+            double(report.getXPosition())/AbsoluteMouseReport::max_x_coordinate,
+            double(report.getYPosition())/AbsoluteMouseReport::max_y_coordinate);
       }
+   
+      generateButtonEvents(*backend_, previous_report_, report);
    }
    
    // TODO: Why does the absolute mouse report not two types of wheel info?
-   
-   // X11 defines mouse button 6 as horizontal scroll wheel left action and mouse
-   // button 7 as horizontal scroll wheel down action.
    //
-//    if(h_wheel > 0) {
-//       for(int i = 0; i < h_wheel; ++i) {
-//          XTestFakeButtonEvent (d, 6, True,  CurrentTime);
-//       }
-//    }
-//    else if(h_wheel < 0) {
-//       for(int i = 0; i > h_wheel; --i) {
-//          XTestFakeButtonEvent (d, 7, True,  CurrentTime);
-//       }
-//    }
+   this->addWheelMovement(report.getVerticalWheel(), 0);
          
-   XSync(d, 0);
+   this->reportProcessed();
+   
+   this->cachePreviousReport();
    
    return true;
 }
@@ -396,7 +366,3 @@ bool GenerateHostEvent<AbsoluteMouseReport>::Action::evalInternal()
 } // namespace actions
 } // namespace simulator
 } // namespace kaleidoscope
-
-#else
-#error __CLANG_ATOMIC_LLONG_LOCK_FREE
-#endif
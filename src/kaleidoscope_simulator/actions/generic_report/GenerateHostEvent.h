@@ -19,8 +19,12 @@
 
 #include "papilio/actions/generic_report/ReportAction.h"
 #include "papilio/reports/Report_.h"
+#include "papilio/actions/Action_.h"
+#include "kaleidoscope_simulator/HostEventBackend.h"
 
 #include <cassert>
+#include <memory>
+#include <stdint.h>
 
 namespace kaleidoscope {
 namespace simulator {
@@ -28,17 +32,108 @@ namespace actions {
    
 /// @private
 ///
+struct SharedHostEventBackend;
+   
+/// @brief Common base of host event actions. Controls when generated 
+///        events are sent to the host system.
+///
 class HostEventAction
 {
    public:
       
+      /// @brief Defines when generated events are sent to the host system.
+      ///
+      enum class FlushPolicy {
+         
+         /// Send the events of every report and wait for the host system
+         /// to process them (a round trip per report).
+         ///
+         sync_each_report,
+         
+         /// Send the events of every report without waiting for 
+         /// the host system.
+         ///
+         flush_each_report,
+         
+         /// Queue events and send them when the flush interval has
+         /// elapsed since the last flush.
+         ///
+         interval,
+         
+         /// Queue events and only send them on flushAll() (see the cycle
+         /// action FlushHostEvents) or when the action is destroyed.
+         ///
+         explicit_only
+      };
+      
       HostEventAction();
             
       ~HostEventAction();
       
+      // Actions register their address.
+      //
+      HostEventAction(const HostEventAction &) = delete;
+      HostEventAction(HostEventAction &&) = delete;
+      HostEventAction &operator=(const HostEventAction &) = delete;
+      HostEventAction &operator=(HostEventAction &&) = delete;
+      
+      /// @brief Sets the flush policy of all host event actions.
+      /// @details With the policies interval and explicit_only, consecutive
+      ///        wheel movements in the same direction are accumulated and 
+      ///        sent as a single wheel event. Pending wheel movement is sent
+      ///        before any other event and before a movement in the 
+      ///        opposite direction, which preserves the order of events.
+      /// @param policy The flush policy.
+      /// @param interval_ms The flush interval [ms] (wall clock),
+      ///        only used with FlushPolicy::interval.
+      ///
+      static void setFlushPolicy(FlushPolicy policy, uint32_t interval_ms = 10);
+      
+      /// @brief Sends the queued events of all host event actions
+      ///        to the host system.
+      ///
+      static void flushAll();
+      
+      /// @brief Sets the backend that receives the events of host 
+      ///        event actions created afterwards.
+      /// @details By default, all host event actions share a backend
+      ///        created by createDefaultHostEventBackend(). It is
+      ///        destroyed with the last action that uses it.
+      /// @param backend The backend. Pass an empty pointer to
+      ///        restore the default.
+      ///
+      static void setBackend(const std::shared_ptr<HostEventBackend> &backend);
+      
    protected:
       
-      void *display_ = nullptr;
+      // Adds wheel movement [ticks] to be sent with the next flush.
+      //
+      void addWheelMovement(int vertical, int horizontal);
+      
+      // Sends the wheel movement that is pending for the backend. 
+      // Must be called before any other event is sent to the backend.
+      //
+      void sendPendingWheelMovement();
+      
+      // Applies the flush policy. Called after the events of a report 
+      // have been generated.
+      //
+      void reportProcessed();
+      
+      void flush();
+      
+   protected:
+      
+      std::shared_ptr<HostEventBackend> backend_;
+      
+   private:
+      
+      // Shared by all actions that use the same backend. Holds
+      // the pending wheel movement.
+      //
+      std::shared_ptr<SharedHostEventBackend> shared_backend_;
+      
+      bool events_pending_ = false;
 };
    
 /// @brief Generates an event that has the same effect as the report being
@@ -70,19 +165,64 @@ class GenerateHostEvent
             
          private:
          
+            // The previous report is kept by value. Its report data is
+            // overwritten in place, which avoids an allocation per report.
+            //
             void cachePreviousReport() {
-               previous_report_ 
-                  = std::static_pointer_cast<_ReportType>(this->getReport().clone());
+               previous_report_.setReportData(
+                  static_cast<const _ReportType&>(this->getReport()).getReportData());
+               previous_report_valid_ = true;
             }
             
          private:
             
-            std::shared_ptr<_ReportType> previous_report_;
+            // Empty until the first report has been processed.
+            //
+            _ReportType previous_report_;
+            bool previous_report_valid_ = false;
       };
    
    PAPILIO_AUTO_DEFINE_ACTION_INVENTORY_TMPL(GenerateHostEvent<_ReportType>)
 };
 
+/// @brief A cycle action that sends all queued host events to the 
+///        host system (see HostEventAction::setFlushPolicy(...)).
+/// @details Add it as permanent cycle action to flush once per cycle.
+///
+///        @code
+///        HostEventAction::setFlushPolicy(HostEventAction::FlushPolicy::explicit_only);
+///        simulator.permanentCycleActions().add(FlushHostEvents{});
+///        @endcode
+///
+class FlushHostEvents
+{
+   public:
+
+      FlushHostEvents() : FlushHostEvents(DelegateConstruction{}) {}
+   
+   private:
+      
+      class Action : public papilio::Action_
+      {
+         public:
+
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Flushing host events";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               this->describe(add_indent);
+            }
+
+            virtual bool evalInternal() override {
+               HostEventAction::flushAll();
+               return true;
+            }
+      };
+   
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(FlushHostEvents)
+};
+
 } // namespace actions
 } // namespace simulator
 } // namespace kaleidoscope
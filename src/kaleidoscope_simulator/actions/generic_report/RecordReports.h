@@ -0,0 +1,114 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/ReportTrace.h"
+#include "kaleidoscope_simulator/reports/ReportTypes.h"
+
+#include "papilio/actions/generic_report/ReportAction.h"
+#include "papilio/reports/Report_.h"
+#include "papilio/Simulator.h"
+
+#include <memory>
+
+namespace kaleidoscope {
+namespace simulator {
+namespace actions {
+
+/// @brief Appends every report to a binary trace file (see ReportTraceWriter).
+/// @details Meant to be used as a permanent report action.
+///
+///        @code
+///        simulator.permanentReportActions().add(RecordReports{"run.ksrt"});
+///        @endcode
+///
+///        The trace is written when the action's buffer is full, when
+///        the action is destroyed and on ReportTraceWriter::flushAll().
+///        The latter is also called before processes of checkpoints
+///        and parallel test runners terminate.
+///
+class RecordReports {
+
+   public:
+
+      /// @brief Constructor.
+      /// @param filename The name of the trace file. An existing
+      ///        file is overwritten.
+      /// @param buffer_size The size of the write buffer [bytes].
+      ///
+      RecordReports(const char *filename, size_t buffer_size = 1 << 16)
+         : RecordReports(DelegateConstruction{}, filename, buffer_size)
+      {}
+
+   private:
+
+      class Action : public papilio::ReportAction<papilio::Report_> {
+
+         public:
+
+            Action(const char *filename, size_t buffer_size) 
+               : writer_(filename, buffer_size) 
+            {}
+
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Recording report to trace file "
+                  << writer_.getFilename();
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               this->getSimulator()->log() << add_indent << writer_.getNumRecords()
+                  << " reports recorded to trace file " << writer_.getFilename();
+            }
+
+            virtual bool evalInternal() override {
+
+               if(!writer_.good()) {
+                  if(!error_reported_) {
+                     this->getSimulator()->error() << "Failed writing report trace file "
+                        << writer_.getFilename();
+                     error_reported_ = true;
+                  }
+                  return false;
+               }
+
+               const auto &simulator = *this->getSimulator();
+
+               visitReport(this->getReport(), [this, &simulator](const auto &report) {
+                  typedef typename std::decay<decltype(report)>::type ReportType;
+                  writer_.write(simulator.getCurrentCycle(), simulator.getTime(),
+                                ReportType::hid_report_type_,
+                                &report.getReportData(),
+                                sizeof(report.getReportData()));
+               });
+
+               return true;
+            }
+
+         private:
+
+            ReportTraceWriter writer_;
+            bool error_reported_ = false;
+      };
+
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(RecordReports)
+};
+
+} // namespace actions
+} // namespace simulator
+} // namespace kaleidoscope
@@ -1,5 +1,5 @@
 /* -*- mode: c++ -*-
- * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard 
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
  *                         firmware.
  * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
  *
@@ -16,37 +16,42 @@
  * this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifdef KALEIDOSCOPE_VIRTUAL_BUILD
+#include "kaleidoscope_simulator/aux/BackgroundThreads.h"
 
-#include "Kaleidoscope-Simulator.h"
-
-#include <iostream>
-#include <ctime>
-   
-KALEIDOSCOPE_SIMULATOR_INIT
+#include <algorithm>
+#include <mutex>
+#include <vector>
 
 namespace kaleidoscope {
 namespace simulator {
    
-void runSimulator(Simulator &simulator) {
-
-   // Loop cycle timing
-   auto begin = std::clock();
+namespace {
    
-   static constexpr int n_cycles = 10000;
-   static constexpr double inv_clocks_per_sec = 1.0/CLOCKS_PER_SEC;
-   
-   simulator.cycles(n_cycles);
+std::mutex background_threads_mutex;
+std::vector<const char*> background_threads;
 
-   auto end = std::clock();
-   double elapsed_secs = double(end - begin)*inv_clocks_per_sec;
-   double elapsed_secs_per_cycle = elapsed_secs/n_cycles;
+} // namespace
    
-   simulator.log() << "elapsed [s]: " << elapsed_secs;
-   simulator.log() << "cycle duration: " << elapsed_secs_per_cycle;
+void registerBackgroundThread(const char *name)
+{
+   std::lock_guard<std::mutex> lock{background_threads_mutex};
+   background_threads.push_back(name);
 }
 
+void unregisterBackgroundThread(const char *name)
+{
+   std::lock_guard<std::mutex> lock{background_threads_mutex};
+   auto it = std::find(background_threads.begin(), background_threads.end(), name);
+   if(it != background_threads.end()) {
+      background_threads.erase(it);
+   }
+}
+
+const char *getRunningBackgroundThread()
+{
+   std::lock_guard<std::mutex> lock{background_threads_mutex};
+   return background_threads.empty() ? nullptr : background_threads.front();
+}
+   
 } // namespace simulator
 } // namespace kaleidoscope
-
-#endif
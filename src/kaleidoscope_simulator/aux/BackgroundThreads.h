@@ -0,0 +1,48 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+namespace kaleidoscope {
+namespace simulator {
+   
+/// @brief Registers a running background thread of the simulator library.
+/// @details fork() only copies the calling thread. The background threads
+///        of AsyncLogSink and RenderThread would be missing in the child 
+///        process, while their buffered output would be emitted by both 
+///        processes. Functions that fork (Simulator::checkpoint(), 
+///        ParallelTestRunner::run(...)) therefore refuse to do so while
+///        any background thread is registered.
+/// @param name The name of the owning class, used in error messages.
+///        Must be a string literal.
+///
+void registerBackgroundThread(const char *name);
+
+/// @brief Unregisters a background thread after it was joined.
+/// @param name The name that was passed to registerBackgroundThread(...).
+///
+void unregisterBackgroundThread(const char *name);
+
+/// @brief Retreives the name of a running background thread.
+/// @returns The name of any registered background thread or nullptr 
+///        if there is none.
+///
+const char *getRunningBackgroundThread();
+   
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,208 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief A fixed size bitset that operates on 64 bit words.
+/// @details Iteration over set bits uses count-trailing-zeros,
+///        counting uses popcount. Bits beyond the bitset size are
+///        always kept zero.
+///
+template<size_t _NBits>
+class Bitset
+{
+   public:
+
+      static constexpr size_t n_bits = _NBits;
+      static constexpr size_t n_words = (_NBits + 63)/64;
+
+      Bitset() : words_{} {}
+
+      /// @brief Sets a bit.
+      /// @param i The bit index.
+      ///
+      void set(size_t i) {
+         words_[i/64] |= uint64_t(1) << (i%64);
+      }
+
+      /// @brief Clears a bit.
+      /// @param i The bit index.
+      ///
+      void reset(size_t i) {
+         words_[i/64] &= ~(uint64_t(1) << (i%64));
+      }
+
+      /// @brief Sets or clears a bit.
+      /// @param i The bit index.
+      /// @param state The new bit state.
+      ///
+      void set(size_t i, bool state) {
+         if(state) { this->set(i); } else { this->reset(i); }
+      }
+
+      /// @brief Queries a bit.
+      /// @param i The bit index.
+      /// @returns The bit state.
+      ///
+      bool test(size_t i) const {
+         return (words_[i/64] >> (i%64)) & 1;
+      }
+
+      /// @brief Overwrites a range of bytes of the bitset.
+      /// @details Byte i holds bits 8*i to 8*i+7, least significant bit first.
+      ///        Bytes outside the range remain unchanged.
+      /// @param bytes The bytes to assign.
+      /// @param n_bytes The number of bytes to assign.
+      /// @param byte_offset The index of the first byte to overwrite.
+      ///
+      void assignBytes(const uint8_t *bytes, size_t n_bytes, size_t byte_offset = 0) {
+         for(size_t i = 0; i < n_bytes; ++i) {
+            size_t b = byte_offset + i;
+            uint64_t &word = words_[b/8];
+            int shift = 8*(b%8);
+            word = (word & ~(uint64_t(0xFF) << shift)) | (uint64_t(bytes[i]) << shift);
+         }
+      }
+
+      /// @brief Clears all bits.
+      ///
+      void clear() {
+         for(size_t w = 0; w < n_words; ++w) { words_[w] = 0; }
+      }
+
+      /// @brief Checks if any bit is set.
+      ///
+      bool any() const {
+         uint64_t accu = 0;
+         for(size_t w = 0; w < n_words; ++w) { accu |= words_[w]; }
+         return accu != 0;
+      }
+
+      /// @brief Checks if no bit is set.
+      ///
+      bool none() const { return !this->any(); }
+
+      /// @brief Counts the bits that are set.
+      ///
+      size_t count() const {
+         size_t n = 0;
+         for(size_t w = 0; w < n_words; ++w) {
+            n += __builtin_popcountll(words_[w]);
+         }
+         return n;
+      }
+
+      /// @brief Checks if all bits that are set are also set in another bitset.
+      /// @param other The potential superset.
+      ///
+      bool isSubsetOf(const Bitset &other) const {
+         uint64_t accu = 0;
+         for(size_t w = 0; w < n_words; ++w) {
+            accu |= words_[w] & ~other.words_[w];
+         }
+         return accu == 0;
+      }
+
+      /// @brief Checks if any bit is set in both bitsets.
+      /// @param other The other bitset.
+      ///
+      bool intersects(const Bitset &other) const {
+         uint64_t accu = 0;
+         for(size_t w = 0; w < n_words; ++w) {
+            accu |= words_[w] & other.words_[w];
+         }
+         return accu != 0;
+      }
+
+      /// @brief Calls a function for the index of every bit that is set,
+      ///        in ascending order.
+      /// @param f The function to call. Signature void(size_t).
+      ///
+      template<typename _Func>
+      void forEach(_Func f) const {
+         for(size_t w = 0; w < n_words; ++w) {
+            uint64_t word = words_[w];
+            while(word) {
+               f(w*64 + __builtin_ctzll(word));
+               word &= word - 1;
+            }
+         }
+      }
+
+      /// @brief Direct access to the underlying words.
+      ///
+      uint64_t word(size_t w) const { return words_[w]; }
+
+      Bitset &operator&=(const Bitset &other) {
+         for(size_t w = 0; w < n_words; ++w) { words_[w] &= other.words_[w]; }
+         return *this;
+      }
+
+      Bitset &operator|=(const Bitset &other) {
+         for(size_t w = 0; w < n_words; ++w) { words_[w] |= other.words_[w]; }
+         return *this;
+      }
+
+      Bitset &operator^=(const Bitset &other) {
+         for(size_t w = 0; w < n_words; ++w) { words_[w] ^= other.words_[w]; }
+         return *this;
+      }
+
+      Bitset operator&(const Bitset &other) const { return Bitset{*this} &= other; }
+      Bitset operator|(const Bitset &other) const { return Bitset{*this} |= other; }
+      Bitset operator^(const Bitset &other) const { return Bitset{*this} ^= other; }
+
+      /// @brief Returns the bits that are set in this bitset but not
+      ///        in another one.
+      /// @param other The other bitset.
+      ///
+      Bitset without(const Bitset &other) const {
+         Bitset result;
+         for(size_t w = 0; w < n_words; ++w) {
+            result.words_[w] = words_[w] & ~other.words_[w];
+         }
+         return result;
+      }
+
+      bool operator==(const Bitset &other) const {
+         uint64_t accu = 0;
+         for(size_t w = 0; w < n_words; ++w) {
+            accu |= words_[w] ^ other.words_[w];
+         }
+         return accu == 0;
+      }
+
+      bool operator!=(const Bitset &other) const { return !(*this == other); }
+
+   private:
+
+      uint64_t words_[n_words];
+};
+
+/// @brief A set of HID keycodes, one bit per keycode.
+///
+typedef Bitset<256> KeycodeBitset;
+
+} // namespace simulator
+} // namespace kaleidoscope
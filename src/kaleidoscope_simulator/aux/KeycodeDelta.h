@@ -0,0 +1,138 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/aux/Bitset.h"
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief The keycode transitions between two keyboard reports.
+/// @details The changed keycodes are determined by XORing the words of 
+///        the keycode sets of both reports. Iteration over transitions
+///        uses count-trailing-zeros. Nothing is allocated on the heap.
+///
+///        @code
+///        KeycodeDelta delta{previous_report.getActiveKeycodeBitset(),
+///                           current_report.getActiveKeycodeBitset()};
+///        delta.forEachTransition([](uint8_t keycode, bool pressed) { ... });
+///        @endcode
+///
+class KeycodeDelta
+{
+   public:
+      
+      /// @brief The index of the word that holds the modifier keycodes.
+      ///
+      static constexpr size_t modifier_word = 0xE0/64;
+      
+      /// @brief The bits of the modifier keycodes (0xE0 to 0xE7) in their word.
+      ///
+      static constexpr uint64_t modifier_mask = uint64_t(0xFF) << (0xE0 % 64);
+      
+      /// @brief Constructor.
+      /// @param previous The keycodes active in the previous report.
+      /// @param current The keycodes active in the current report.
+      ///
+      KeycodeDelta(const KeycodeBitset &previous, const KeycodeBitset &current)
+      {
+         for(size_t w = 0; w < KeycodeBitset::n_words; ++w) {
+            uint64_t changed = previous.word(w) ^ current.word(w);
+            pressed_[w] = changed & current.word(w);
+            released_[w] = changed & previous.word(w);
+         }
+      }
+      
+      /// @brief Checks if any keycode was pressed or released.
+      ///
+      bool any() const {
+         uint64_t accu = 0;
+         for(size_t w = 0; w < KeycodeBitset::n_words; ++w) {
+            accu |= pressed_[w] | released_[w];
+         }
+         return accu != 0;
+      }
+      
+      /// @brief Calls a function for every pressed keycode, in ascending order.
+      /// @param f The function to call. Signature void(uint8_t keycode).
+      ///
+      template<typename _Func>
+      void forEachPressed(_Func f) const {
+         for(size_t w = 0; w < KeycodeBitset::n_words; ++w) {
+            forEachBit(w, pressed_[w], f);
+         }
+      }
+      
+      /// @brief Calls a function for every released keycode, in ascending order.
+      /// @param f The function to call. Signature void(uint8_t keycode).
+      ///
+      template<typename _Func>
+      void forEachReleased(_Func f) const {
+         for(size_t w = 0; w < KeycodeBitset::n_words; ++w) {
+            forEachBit(w, released_[w], f);
+         }
+      }
+      
+      /// @brief Calls a function for every pressed or released keycode.
+      /// @details Modifier transitions are visited first, so that a key 
+      ///        that is pressed together with a modifier is pressed while
+      ///        the modifier is already active. Other transitions 
+      ///        follow in ascending keycode order.
+      /// @param f The function to call. Signature 
+      ///        void(uint8_t keycode, bool pressed).
+      ///
+      template<typename _Func>
+      void forEachTransition(_Func f) const {
+         
+         this->forEachTransitionInWord(modifier_word, modifier_mask, f);
+         
+         for(size_t w = 0; w < KeycodeBitset::n_words; ++w) {
+            this->forEachTransitionInWord(
+               w, (w == modifier_word) ? ~modifier_mask : ~uint64_t(0), f);
+         }
+      }
+      
+   private:
+      
+      template<typename _Func>
+      static void forEachBit(size_t w, uint64_t word, _Func &f) {
+         while(word) {
+            f(static_cast<uint8_t>(w*64 + __builtin_ctzll(word)));
+            word &= word - 1;
+         }
+      }
+      
+      template<typename _Func>
+      void forEachTransitionInWord(size_t w, uint64_t mask, _Func &f) const {
+         uint64_t changed = (pressed_[w] | released_[w]) & mask;
+         while(changed) {
+            auto i = __builtin_ctzll(changed);
+            f(static_cast<uint8_t>(w*64 + i), ((pressed_[w] >> i) & 1) != 0);
+            changed &= changed - 1;
+         }
+      }
+      
+   private:
+      
+      uint64_t pressed_[KeycodeBitset::n_words];
+      uint64_t released_[KeycodeBitset::n_words];
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,174 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @private
+/// @brief A thread local free list of fixed size memory slots.
+/// @details Slots are allocated individually with operator new and are
+///        recycled instead of being returned to the heap. Every slot
+///        is therefore independent of the thread that allocated it and
+///        may be released on any thread. The number of recycled slots
+///        is bounded. Slots that are released after the free list
+///        has been drained at thread exit are returned to the heap.
+///
+template<std::size_t _SlotSize>
+class SlotPool
+{
+   public:
+
+      static constexpr std::size_t max_free_slots = 256;
+
+      static void *allocate() {
+         auto &free_list = getFreeList();
+         if(free_list.head) {
+            FreeSlot *slot = free_list.head;
+            free_list.head = slot->next;
+            --free_list.n_slots;
+            return slot;
+         }
+         return ::operator new(slot_size);
+      }
+
+      static void deallocate(void *p) {
+         auto &free_list = getFreeList();
+         if(free_list.destroyed || (free_list.n_slots >= max_free_slots)) {
+            ::operator delete(p);
+            return;
+         }
+         FreeSlot *slot = static_cast<FreeSlot*>(p);
+         slot->next = free_list.head;
+         free_list.head = slot;
+         ++free_list.n_slots;
+      }
+
+   private:
+
+      struct FreeSlot {
+         FreeSlot *next;
+      };
+
+      static constexpr std::size_t slot_size
+         = (_SlotSize < sizeof(FreeSlot)) ? sizeof(FreeSlot) : _SlotSize;
+
+      // The free list is trivially destructible. It thus remains usable
+      // while other thread local objects, e.g. the default simulator, 
+      // are destroyed after it has been drained.
+      //
+      struct FreeList {
+         FreeSlot *head;
+         std::size_t n_slots;
+         bool destroyed;
+      };
+
+      // Drains the free list when its thread exits. Slots that are
+      // released afterwards are returned to the heap.
+      //
+      struct FreeListGuard {
+         ~FreeListGuard() {
+            auto &free_list = getFreeListStorage();
+            while(free_list.head) {
+               FreeSlot *next = free_list.head->next;
+               ::operator delete(free_list.head);
+               free_list.head = next;
+            }
+            free_list.n_slots = 0;
+            free_list.destroyed = true;
+         }
+      };
+
+      static FreeList &getFreeListStorage() {
+         static thread_local FreeList free_list{nullptr, 0, false};
+         return free_list;
+      }
+
+      static FreeList &getFreeList() {
+         auto &free_list = getFreeListStorage();
+         if(!free_list.destroyed) {
+            static thread_local FreeListGuard guard;
+            (void)guard;
+         }
+         return free_list;
+      }
+};
+
+/// @brief A standard allocator that recycles memory through a SlotPool.
+/// @details Meant to be used with std::allocate_shared. The
+///        control block and the object then share a single slot that is
+///        reused by the next allocation of the same type. Allocations
+///        of more than one object are forwarded to the heap.
+///
+template<typename _T>
+class PoolAllocator
+{
+   public:
+
+      typedef _T value_type;
+
+      template<typename _U>
+      struct rebind { typedef PoolAllocator<_U> other; };
+
+      PoolAllocator() noexcept {}
+
+      template<typename _U>
+      PoolAllocator(const PoolAllocator<_U> &) noexcept {}
+
+      _T *allocate(std::size_t n) {
+         static_assert(alignof(_T) <= alignof(std::max_align_t),
+                       "Over-aligned types are not supported");
+         if(n != 1) {
+            return static_cast<_T*>(::operator new(n*sizeof(_T)));
+         }
+         return static_cast<_T*>(SlotPool<sizeof(_T)>::allocate());
+      }
+
+      void deallocate(_T *p, std::size_t n) noexcept {
+         if(n != 1) {
+            ::operator delete(p);
+            return;
+         }
+         SlotPool<sizeof(_T)>::deallocate(p);
+      }
+};
+
+template<typename _T, typename _U>
+bool operator==(const PoolAllocator<_T> &, const PoolAllocator<_U> &) { return true; }
+
+template<typename _T, typename _U>
+bool operator!=(const PoolAllocator<_T> &, const PoolAllocator<_U> &) { return false; }
+
+/// @brief Creates a shared object whose memory is recycled through a SlotPool.
+/// @param args The constructor arguments.
+///
+template<typename _T, typename..._Args>
+std::shared_ptr<_T> makePooled(_Args &&... args)
+{
+   return std::allocate_shared<_T>(PoolAllocator<_T>{},
+                                   std::forward<_Args>(args)...);
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
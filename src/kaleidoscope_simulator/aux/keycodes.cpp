@@ -0,0 +1,561 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/aux/keycodes.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace kaleidoscope {
+namespace simulator {
+
+// Columns: label, Kaleidoscope key name, dump description,
+//          Linux input event code, modifier flag
+//
+// Event codes are numeric so that the table is available on 
+// all platforms (see /usr/include/linux/input-event-codes.h).
+//
+constexpr KeycodeInfo keycode_table[256] = {
+   /* 0x00 */ { "", "", "NO_EVENT", 0, false },
+   /* 0x01 */ { "", "", "ERROR_ROLLOVER", 0, false },
+   /* 0x02 */ { "", "", "POST_FAIL", 0, false },
+   /* 0x03 */ { "", "", "ERROR_UNDEFINED", 0, false },
+   /* 0x04 */ { "A   ", "A", "a", 30, false },
+   /* 0x05 */ { "B   ", "B", "b", 48, false },
+   /* 0x06 */ { "C   ", "C", "c", 46, false },
+   /* 0x07 */ { "D   ", "D", "d", 32, false },
+   /* 0x08 */ { "E   ", "E", "e", 18, false },
+   /* 0x09 */ { "F   ", "F", "f", 33, false },
+   /* 0x0A */ { "G   ", "G", "g", 34, false },
+   /* 0x0B */ { "H   ", "H", "h", 35, false },
+   /* 0x0C */ { "I   ", "I", "i", 23, false },
+   /* 0x0D */ { "J   ", "J", "j", 36, false },
+   /* 0x0E */ { "K   ", "K", "k", 37, false },
+   /* 0x0F */ { "L   ", "L", "l", 38, false },
+   /* 0x10 */ { "M   ", "M", "m", 50, false },
+   /* 0x11 */ { "N   ", "N", "n", 49, false },
+   /* 0x12 */ { "O   ", "O", "o", 24, false },
+   /* 0x13 */ { "P   ", "P", "p", 25, false },
+   /* 0x14 */ { "Q   ", "Q", "q", 16, false },
+   /* 0x15 */ { "R   ", "R", "r", 19, false },
+   /* 0x16 */ { "S   ", "S", "s", 31, false },
+   /* 0x17 */ { "T   ", "T", "t", 20, false },
+   /* 0x18 */ { "U   ", "U", "u", 22, false },
+   /* 0x19 */ { "V   ", "V", "v", 47, false },
+   /* 0x1A */ { "W   ", "W", "w", 17, false },
+   /* 0x1B */ { "X   ", "X", "x", 45, false },
+   /* 0x1C */ { "Y   ", "Y", "y", 21, false },
+   /* 0x1D */ { "Z   ", "Z", "z", 44, false },
+   /* 0x1E */ { "1 ! ", "1", "1/!", 2, false },
+   /* 0x1F */ { "2 @ ", "2", "2/@", 3, false },
+   /* 0x20 */ { "3 # ", "3", "3/#", 4, false },
+   /* 0x21 */ { "4 $ ", "4", "4/$", 5, false },
+   /* 0x22 */ { "5 % ", "5", "5/%", 6, false },
+   /* 0x23 */ { "6 ^ ", "6", "6/^", 7, false },
+   /* 0x24 */ { "7 & ", "7", "7/&", 8, false },
+   /* 0x25 */ { "8 * ", "8", "8/*", 9, false },
+   /* 0x26 */ { "9 ( ", "9", "9/(", 10, false },
+   /* 0x27 */ { "0 ) ", "0", "0/)", 11, false },
+   /* 0x28 */ { "Entr", "Enter", "enter", 28, false },
+   /* 0x29 */ { "Esc ", "Escape", "esc", 1, false },
+   /* 0x2A */ { "Del ", "Backspace", "del/bksp", 14, false },
+   /* 0x2B */ { "Tab ", "Tab", "tab", 15, false },
+   /* 0x2C */ { "Spce", "Spacebar", "space", 57, false },
+   /* 0x2D */ { "- _ ", "Minus", "-/_", 12, false },
+   /* 0x2E */ { "= + ", "Equals", "=/+", 13, false },
+   /* 0x2F */ { "[ { ", "LeftBracket", "[/{", 26, false },
+   /* 0x30 */ { "] } ", "RightBracket", "]/}", 27, false },
+   /* 0x31 */ { "\\ | ", "Backslash", "\\/|", 43, false },
+   /* 0x32 */ { "   ~ ", "NonUsPound", "#/~", 43, false },
+   /* 0x33 */ { "; , ", "Semicolon", ";/:", 39, false },
+   /* 0x34 */ { "\' \" ", "Quote", "'/\"", 40, false },
+   /* 0x35 */ { "` ~ ", "Backtick", "`/~", 41, false },
+   /* 0x36 */ { ", < ", "Comma", ",/<", 51, false },
+   /* 0x37 */ { ". > ", "Period", "./>", 52, false },
+   /* 0x38 */ { "/ ? ", "Slash", "//?", 53, false },
+   /* 0x39 */ { "C.L.", "CapsLock", "capslock", 58, false },
+   /* 0x3A */ { "F1  ", "F1", "F1", 59, false },
+   /* 0x3B */ { "F2  ", "F2", "F2", 60, false },
+   /* 0x3C */ { "F3  ", "F3", "F3", 61, false },
+   /* 0x3D */ { "F4  ", "F4", "F4", 62, false },
+   /* 0x3E */ { "F5  ", "F5", "F5", 63, false },
+   /* 0x3F */ { "F6  ", "F6", "F6", 64, false },
+   /* 0x40 */ { "F7  ", "F7", "F7", 65, false },
+   /* 0x41 */ { "F8  ", "F8", "F8", 66, false },
+   /* 0x42 */ { "F9  ", "F9", "F9", 67, false },
+   /* 0x43 */ { "F10 ", "F10", "F10", 68, false },
+   /* 0x44 */ { "F11 ", "F11", "F11", 87, false },
+   /* 0x45 */ { "F12 ", "F12", "F12", 88, false },
+   /* 0x46 */ { "PRTS", "PrintScreen", "prtscr", 99, false },
+   /* 0x47 */ { "ScLk", "ScrollLock", "scrolllock", 70, false },
+   /* 0x48 */ { "Pse ", "Pause", "pause", 119, false },
+   /* 0x49 */ { "Isrt", "Insert", "ins", 110, false },
+   /* 0x4A */ { "Home", "Home", "home", 102, false },
+   /* 0x4B */ { "PgUp", "PageUp", "pgup", 104, false },
+   /* 0x4C */ { "Del ", "Delete", "del", 111, false },
+   /* 0x4D */ { "End ", "End", "end", 107, false },
+   /* 0x4E */ { "PgDn", "PageDown", "pgdn", 109, false },
+   /* 0x4F */ { "→   ", "RightArrow", "r_arrow", 106, false },
+   /* 0x50 */ { "←   ", "LeftArrow", "l_arrow", 105, false },
+   /* 0x51 */ { "↓   ", "DownArrow", "d_arrow", 108, false },
+   /* 0x52 */ { "↑   ", "UpArrow", "u_arrow", 103, false },
+   /* 0x53 */ { "NlCl", "KeypadNumLock", "numlock", 69, false },
+   /* 0x54 */ { "/   ", "KeypadDivide", "num/", 98, false },
+   /* 0x55 */ { "*   ", "KeypadMultiply", "num*", 55, false },
+   /* 0x56 */ { "-   ", "KeypadSubtract", "num-", 74, false },
+   /* 0x57 */ { "+   ", "KeypadAdd", "num+", 78, false },
+   /* 0x58 */ { "Entr", "KeypadEnter", "numenter", 96, false },
+   /* 0x59 */ { "1 Ed", "Keypad1", "num1", 79, false },
+   /* 0x5A */ { "2 ↓ ", "Keypad2", "num2", 80, false },
+   /* 0x5B */ { "3 PD", "Keypad3", "num3", 81, false },
+   /* 0x5C */ { "4 ← ", "Keypad4", "num4", 75, false },
+   /* 0x5D */ { "5   ", "Keypad5", "num5", 76, false },
+   /* 0x5E */ { "6 → ", "Keypad6", "num6", 77, false },
+   /* 0x5F */ { "7 Hm", "Keypad7", "num7", 71, false },
+   /* 0x60 */ { "8 ↑ ", "Keypad8", "num8", 72, false },
+   /* 0x61 */ { "9 PU", "Keypad9", "num9", 73, false },
+   /* 0x62 */ { "0 IN", "Keypad0", "num0", 82, false },
+   /* 0x63 */ { ". DL", "KeypadDot", "num.", 83, false },
+   /* 0x64 */ { "\\ | ", "NonUsBackslashAndPipe", "\\/|", 53, false },
+   /* 0x65 */ { "", "PcApplication", "app", 580, false },
+   /* 0x66 */ { "", "Power", "power", 116, false },
+   /* 0x67 */ { "=   ", "KeypadEquals", "num=", 117, false },
+   /* 0x68 */ { "F13 ", "F13", "F13", 183, false },
+   /* 0x69 */ { "F14 ", "F14", "F14", 184, false },
+   /* 0x6A */ { "F15 ", "F15", "F15", 185, false },
+   /* 0x6B */ { "F16 ", "F16", "F16", 186, false },
+   /* 0x6C */ { "F17 ", "F17", "F17", 187, false },
+   /* 0x6D */ { "F18 ", "F18", "F18", 188, false },
+   /* 0x6E */ { "F19 ", "F19", "F19", 189, false },
+   /* 0x6F */ { "F20 ", "F20", "F20", 190, false },
+   /* 0x70 */ { "F21 ", "F21", "F21", 191, false },
+   /* 0x71 */ { "F22 ", "F22", "F22", 192, false },
+   /* 0x72 */ { "F23 ", "F23", "F23", 193, false },
+   /* 0x73 */ { "F24 ", "F24", "F24", 194, false },
+   /* 0x74 */ { "", "Execute", "exec", 134, false },
+   /* 0x75 */ { "", "Help", "help", 138, false },
+   /* 0x76 */ { "", "Menu", "menu", 139, false },
+   /* 0x77 */ { "", "Select", "sel", 353, false },
+   /* 0x78 */ { "", "Stop", "stop", 128, false },
+   /* 0x79 */ { "", "Again", "again", 129, false },
+   /* 0x7A */ { "", "Undo", "undo", 131, false },
+   /* 0x7B */ { "", "Cut", "cut", 137, false },
+   /* 0x7C */ { "", "Copy", "copy", 133, false },
+   /* 0x7D */ { "", "Paste", "paste", 135, false },
+   /* 0x7E */ { "", "Find", "find", 136, false },
+   /* 0x7F */ { "", "Mute", "mute", 113, false },
+   /* 0x80 */ { "", "VolumeUp", "volup", 115, false },
+   /* 0x81 */ { "", "VolumeDown", "voldn", 114, false },
+   /* 0x82 */ { "", "LockingCapsLock", "capslock_l", 240, false },
+   /* 0x83 */ { "", "LockingNumLock", "numlock_l", 240, false },
+   /* 0x84 */ { "", "LockingScrollLock", "scrolllock_l", 240, false },
+   /* 0x85 */ { ",   ", "KeypadComma", "num,", 240, false },
+   /* 0x86 */ { "=   ", "KeypadEqualSign", "num=", 240, false },
+   /* 0x87 */ { "", "International1", "", 240, false },
+   /* 0x88 */ { "", "International2", "", 0, false },
+   /* 0x89 */ { "", "International3", "", 0, false },
+   /* 0x8A */ { "", "International4", "", 0, false },
+   /* 0x8B */ { "", "International5", "", 0, false },
+   /* 0x8C */ { "", "International6", "", 0, false },
+   /* 0x8D */ { "", "International7", "", 0, false },
+   /* 0x8E */ { "", "International8", "", 0, false },
+   /* 0x8F */ { "", "International9", "", 0, false },
+   /* 0x90 */ { "", "Lang1", "", 0, false },
+   /* 0x91 */ { "", "Lang2", "", 0, false },
+   /* 0x92 */ { "", "Lang3", "", 0, false },
+   /* 0x93 */ { "", "Lang4", "", 0, false },
+   /* 0x94 */ { "", "Lang5", "", 0, false },
+   /* 0x95 */ { "", "Lang6", "", 0, false },
+   /* 0x96 */ { "", "Lang7", "", 0, false },
+   /* 0x97 */ { "", "Lang8", "", 0, false },
+   /* 0x98 */ { "", "Lang9", "", 0, false },
+   /* 0x99 */ { "", "AlternateErase", "", 0, false },
+   /* 0x9A */ { "", "Sysreq", "", 0, false },
+   /* 0x9B */ { "", "Cancel", "", 0, false },
+   /* 0x9C */ { "", "Clear", "", 0, false },
+   /* 0x9D */ { "", "Prior", "", 0, false },
+   /* 0x9E */ { "", "Return", "", 0, false },
+   /* 0x9F */ { "", "Separator", "", 0, false },
+   /* 0xA0 */ { "", "Out", "", 0, false },
+   /* 0xA1 */ { "", "Oper", "", 0, false },
+   /* 0xA2 */ { "", "ClearSlashAgain", "", 0, false },
+   /* 0xA3 */ { "", "CrselSlashProps", "", 0, false },
+   /* 0xA4 */ { "", "Exsel", "", 0, false },
+   /* 0xA5 */ { "", "", "", 0, false },
+   /* 0xA6 */ { "", "", "", 0, false },
+   /* 0xA7 */ { "", "", "", 0, false },
+   /* 0xA8 */ { "", "", "", 0, false },
+   /* 0xA9 */ { "", "", "", 0, false },
+   /* 0xAA */ { "", "", "", 0, false },
+   /* 0xAB */ { "", "", "", 0, false },
+   /* 0xAC */ { "", "", "", 0, false },
+   /* 0xAD */ { "", "", "", 0, false },
+   /* 0xAE */ { "", "", "", 0, false },
+   /* 0xAF */ { "", "", "", 0, false },
+   /* 0xB0 */ { "", "Keypad00", "", 0, false },
+   /* 0xB1 */ { "", "Keypad000", "", 0, false },
+   /* 0xB2 */ { "", "ThousandsSeparator", "", 0, false },
+   /* 0xB3 */ { "", "DecimalSeparator", "", 0, false },
+   /* 0xB4 */ { "", "CurrencyUnit", "", 0, false },
+   /* 0xB5 */ { "", "CurrencySubunit", "", 0, false },
+   /* 0xB6 */ { "", "KeypadLeftParen", "", 0, false },
+   /* 0xB7 */ { "", "KeypadRightParen", "", 0, false },
+   /* 0xB8 */ { "", "KeypadLeftCurlyBrace", "", 0, false },
+   /* 0xB9 */ { "", "KeypadRightCurlyBrace", "", 0, false },
+   /* 0xBA */ { "", "KeypadTab", "", 0, false },
+   /* 0xBB */ { "", "KeypadBackspace", "", 0, false },
+   /* 0xBC */ { "", "KeypadA", "", 0, false },
+   /* 0xBD */ { "", "KeypadB", "", 0, false },
+   /* 0xBE */ { "", "KeypadC", "", 0, false },
+   /* 0xBF */ { "", "KeypadD", "", 0, false },
+   /* 0xC0 */ { "", "KeypadE", "", 0, false },
+   /* 0xC1 */ { "", "KeypadF", "", 0, false },
+   /* 0xC2 */ { "", "KeypadXor", "", 0, false },
+   /* 0xC3 */ { "", "KeypadCarat", "", 0, false },
+   /* 0xC4 */ { "", "KeypadPercent", "", 0, false },
+   /* 0xC5 */ { "", "KeypadLessThan", "", 0, false },
+   /* 0xC6 */ { "", "KeypadGreaterThan", "", 0, false },
+   /* 0xC7 */ { "", "KeypadAmpersand", "", 0, false },
+   /* 0xC8 */ { "", "KeypadDoubleampersand", "", 0, false },
+   /* 0xC9 */ { "", "KeypadPipe", "", 0, false },
+   /* 0xCA */ { "", "KeypadDoublepipe", "", 0, false },
+   /* 0xCB */ { "", "KeypadColon", "", 0, false },
+   /* 0xCC */ { "", "KeypadPoundSign", "", 0, false },
+   /* 0xCD */ { "", "KeypadSpace", "", 0, false },
+   /* 0xCE */ { "", "KeypadAtSign", "", 0, false },
+   /* 0xCF */ { "", "KeypadExclamationPoint", "", 0, false },
+   /* 0xD0 */ { "", "KeypadMemoryStore", "", 0, false },
+   /* 0xD1 */ { "", "KeypadMemoryRecall", "", 0, false },
+   /* 0xD2 */ { "", "KeypadMemoryClear", "", 0, false },
+   /* 0xD3 */ { "", "KeypadMemoryAdd", "", 0, false },
+   /* 0xD4 */ { "", "KeypadMemorySubtract", "", 0, false },
+   /* 0xD5 */ { "", "KeypadMemoryMultiply", "", 0, false },
+   /* 0xD6 */ { "", "KeypadMemoryDivide", "", 0, false },
+   /* 0xD7 */ { "", "KeypadPlusSlashMinus", "", 0, false },
+   /* 0xD8 */ { "", "KeypadClear", "", 0, false },
+   /* 0xD9 */ { "", "KeypadClearEntry", "", 0, false },
+   /* 0xDA */ { "", "KeypadBinary", "", 0, false },
+   /* 0xDB */ { "", "KeypadOctal", "", 0, false },
+   /* 0xDC */ { "", "KeypadDecimal", "", 0, false },
+   /* 0xDD */ { "", "KeypadHexadecimal", "", 0, false },
+   /* 0xDE */ { "", "", "", 0, false },
+   /* 0xDF */ { "", "", "", 0, false },
+   /* 0xE0 */ { "", "LeftControl", "lctrl", 29, true },
+   /* 0xE1 */ { "", "LeftShift", "lshift", 42, true },
+   /* 0xE2 */ { "", "LeftAlt", "lalt", 56, true },
+   /* 0xE3 */ { "", "LeftGui", "lgui", 125, true },
+   /* 0xE4 */ { "", "RightControl", "rctrl", 97, true },
+   /* 0xE5 */ { "", "RightShift", "rshift", 54, true },
+   /* 0xE6 */ { "", "RightAlt", "ralt", 100, true },
+   /* 0xE7 */ { "", "RightGui", "rgui", 126, true },
+   /* 0xE8 */ { "", "", "", 0, false },
+   /* 0xE9 */ { "", "", "", 0, false },
+   /* 0xEA */ { "", "", "", 0, false },
+   /* 0xEB */ { "", "", "", 0, false },
+   /* 0xEC */ { "", "", "", 0, false },
+   /* 0xED */ { "", "", "", 0, false },
+   /* 0xEE */ { "", "", "", 0, false },
+   /* 0xEF */ { "", "", "", 0, false },
+   /* 0xF0 */ { "", "", "", 0, false },
+   /* 0xF1 */ { "", "", "", 0, false },
+   /* 0xF2 */ { "", "", "", 0, false },
+   /* 0xF3 */ { "", "", "", 0, false },
+   /* 0xF4 */ { "", "", "", 0, false },
+   /* 0xF5 */ { "", "", "", 0, false },
+   /* 0xF6 */ { "", "", "", 0, false },
+   /* 0xF7 */ { "", "", "", 0, false },
+   /* 0xF8 */ { "", "", "", 0, false },
+   /* 0xF9 */ { "", "", "", 0, false },
+   /* 0xFA */ { "", "", "", 0, false },
+   /* 0xFB */ { "", "", "", 0, false },
+   /* 0xFC */ { "", "", "", 0, false },
+   /* 0xFD */ { "", "", "", 0, false },
+   /* 0xFE */ { "", "", "", 0, false },
+   /* 0xFF */ { "", "", "", 0, false }
+};
+
+namespace {
+
+struct NameIndexEntry {
+   const char *name;
+   uint8_t keycode;
+};
+
+// Key names in ascending strcmp order
+//
+constexpr NameIndexEntry name_index[] = {
+   { "0", 0x27 },
+   { "1", 0x1E },
+   { "2", 0x1F },
+   { "3", 0x20 },
+   { "4", 0x21 },
+   { "5", 0x22 },
+   { "6", 0x23 },
+   { "7", 0x24 },
+   { "8", 0x25 },
+   { "9", 0x26 },
+   { "A", 0x04 },
+   { "Again", 0x79 },
+   { "AlternateErase", 0x99 },
+   { "B", 0x05 },
+   { "Backslash", 0x31 },
+   { "Backspace", 0x2A },
+   { "Backtick", 0x35 },
+   { "C", 0x06 },
+   { "Cancel", 0x9B },
+   { "CapsLock", 0x39 },
+   { "Clear", 0x9C },
+   { "ClearSlashAgain", 0xA2 },
+   { "Comma", 0x36 },
+   { "Copy", 0x7C },
+   { "CrselSlashProps", 0xA3 },
+   { "CurrencySubunit", 0xB5 },
+   { "CurrencyUnit", 0xB4 },
+   { "Cut", 0x7B },
+   { "D", 0x07 },
+   { "DecimalSeparator", 0xB3 },
+   { "Delete", 0x4C },
+   { "DownArrow", 0x51 },
+   { "E", 0x08 },
+   { "End", 0x4D },
+   { "Enter", 0x28 },
+   { "Equals", 0x2E },
+   { "Escape", 0x29 },
+   { "Execute", 0x74 },
+   { "Exsel", 0xA4 },
+   { "F", 0x09 },
+   { "F1", 0x3A },
+   { "F10", 0x43 },
+   { "F11", 0x44 },
+   { "F12", 0x45 },
+   { "F13", 0x68 },
+   { "F14", 0x69 },
+   { "F15", 0x6A },
+   { "F16", 0x6B },
+   { "F17", 0x6C },
+   { "F18", 0x6D },
+   { "F19", 0x6E },
+   { "F2", 0x3B },
+   { "F20", 0x6F },
+   { "F21", 0x70 },
+   { "F22", 0x71 },
+   { "F23", 0x72 },
+   { "F24", 0x73 },
+   { "F3", 0x3C },
+   { "F4", 0x3D },
+   { "F5", 0x3E },
+   { "F6", 0x3F },
+   { "F7", 0x40 },
+   { "F8", 0x41 },
+   { "F9", 0x42 },
+   { "Find", 0x7E },
+   { "G", 0x0A },
+   { "H", 0x0B },
+   { "Help", 0x75 },
+   { "Home", 0x4A },
+   { "I", 0x0C },
+   { "Insert", 0x49 },
+   { "International1", 0x87 },
+   { "International2", 0x88 },
+   { "International3", 0x89 },
+   { "International4", 0x8A },
+   { "International5", 0x8B },
+   { "International6", 0x8C },
+   { "International7", 0x8D },
+   { "International8", 0x8E },
+   { "International9", 0x8F },
+   { "J", 0x0D },
+   { "K", 0x0E },
+   { "Keypad0", 0x62 },
+   { "Keypad00", 0xB0 },
+   { "Keypad000", 0xB1 },
+   { "Keypad1", 0x59 },
+   { "Keypad2", 0x5A },
+   { "Keypad3", 0x5B },
+   { "Keypad4", 0x5C },
+   { "Keypad5", 0x5D },
+   { "Keypad6", 0x5E },
+   { "Keypad7", 0x5F },
+   { "Keypad8", 0x60 },
+   { "Keypad9", 0x61 },
+   { "KeypadA", 0xBC },
+   { "KeypadAdd", 0x57 },
+   { "KeypadAmpersand", 0xC7 },
+   { "KeypadAtSign", 0xCE },
+   { "KeypadB", 0xBD },
+   { "KeypadBackspace", 0xBB },
+   { "KeypadBinary", 0xDA },
+   { "KeypadC", 0xBE },
+   { "KeypadCarat", 0xC3 },
+   { "KeypadClear", 0xD8 },
+   { "KeypadClearEntry", 0xD9 },
+   { "KeypadColon", 0xCB },
+   { "KeypadComma", 0x85 },
+   { "KeypadD", 0xBF },
+   { "KeypadDecimal", 0xDC },
+   { "KeypadDivide", 0x54 },
+   { "KeypadDot", 0x63 },
+   { "KeypadDoubleampersand", 0xC8 },
+   { "KeypadDoublepipe", 0xCA },
+   { "KeypadE", 0xC0 },
+   { "KeypadEnter", 0x58 },
+   { "KeypadEqualSign", 0x86 },
+   { "KeypadEquals", 0x67 },
+   { "KeypadExclamationPoint", 0xCF },
+   { "KeypadF", 0xC1 },
+   { "KeypadGreaterThan", 0xC6 },
+   { "KeypadHexadecimal", 0xDD },
+   { "KeypadLeftCurlyBrace", 0xB8 },
+   { "KeypadLeftParen", 0xB6 },
+   { "KeypadLessThan", 0xC5 },
+   { "KeypadMemoryAdd", 0xD3 },
+   { "KeypadMemoryClear", 0xD2 },
+   { "KeypadMemoryDivide", 0xD6 },
+   { "KeypadMemoryMultiply", 0xD5 },
+   { "KeypadMemoryRecall", 0xD1 },
+   { "KeypadMemoryStore", 0xD0 },
+   { "KeypadMemorySubtract", 0xD4 },
+   { "KeypadMultiply", 0x55 },
+   { "KeypadNumLock", 0x53 },
+   { "KeypadOctal", 0xDB },
+   { "KeypadPercent", 0xC4 },
+   { "KeypadPipe", 0xC9 },
+   { "KeypadPlusSlashMinus", 0xD7 },
+   { "KeypadPoundSign", 0xCC },
+   { "KeypadRightCurlyBrace", 0xB9 },
+   { "KeypadRightParen", 0xB7 },
+   { "KeypadSpace", 0xCD },
+   { "KeypadSubtract", 0x56 },
+   { "KeypadTab", 0xBA },
+   { "KeypadXor", 0xC2 },
+   { "L", 0x0F },
+   { "Lang1", 0x90 },
+   { "Lang2", 0x91 },
+   { "Lang3", 0x92 },
+   { "Lang4", 0x93 },
+   { "Lang5", 0x94 },
+   { "Lang6", 0x95 },
+   { "Lang7", 0x96 },
+   { "Lang8", 0x97 },
+   { "Lang9", 0x98 },
+   { "LeftAlt", 0xE2 },
+   { "LeftArrow", 0x50 },
+   { "LeftBracket", 0x2F },
+   { "LeftControl", 0xE0 },
+   { "LeftGui", 0xE3 },
+   { "LeftShift", 0xE1 },
+   { "LockingCapsLock", 0x82 },
+   { "LockingNumLock", 0x83 },
+   { "LockingScrollLock", 0x84 },
+   { "M", 0x10 },
+   { "Menu", 0x76 },
+   { "Minus", 0x2D },
+   { "Mute", 0x7F },
+   { "N", 0x11 },
+   { "NonUsBackslashAndPipe", 0x64 },
+   { "NonUsPound", 0x32 },
+   { "O", 0x12 },
+   { "Oper", 0xA1 },
+   { "Out", 0xA0 },
+   { "P", 0x13 },
+   { "PageDown", 0x4E },
+   { "PageUp", 0x4B },
+   { "Paste", 0x7D },
+   { "Pause", 0x48 },
+   { "PcApplication", 0x65 },
+   { "Period", 0x37 },
+   { "Power", 0x66 },
+   { "PrintScreen", 0x46 },
+   { "Prior", 0x9D },
+   { "Q", 0x14 },
+   { "Quote", 0x34 },
+   { "R", 0x15 },
+   { "Return", 0x9E },
+   { "RightAlt", 0xE6 },
+   { "RightArrow", 0x4F },
+   { "RightBracket", 0x30 },
+   { "RightControl", 0xE4 },
+   { "RightGui", 0xE7 },
+   { "RightShift", 0xE5 },
+   { "S", 0x16 },
+   { "ScrollLock", 0x47 },
+   { "Select", 0x77 },
+   { "Semicolon", 0x33 },
+   { "Separator", 0x9F },
+   { "Slash", 0x38 },
+   { "Spacebar", 0x2C },
+   { "Stop", 0x78 },
+   { "Sysreq", 0x9A },
+   { "T", 0x17 },
+   { "Tab", 0x2B },
+   { "ThousandsSeparator", 0xB2 },
+   { "U", 0x18 },
+   { "Undo", 0x7A },
+   { "UpArrow", 0x52 },
+   { "V", 0x19 },
+   { "VolumeDown", 0x81 },
+   { "VolumeUp", 0x80 },
+   { "W", 0x1A },
+   { "X", 0x1B },
+   { "Y", 0x1C },
+   { "Z", 0x1D }
+};
+
+constexpr std::size_t n_names = sizeof(name_index)/sizeof(name_index[0]);
+
+constexpr int constexprStrcmp(const char *a, const char *b)
+{
+   while(*a && (*a == *b)) { ++a; ++b; }
+   return static_cast<unsigned char>(*a) - static_cast<unsigned char>(*b);
+}
+
+constexpr bool isNameIndexValid()
+{
+   for(std::size_t i = 0; i < n_names; ++i) {
+      if((i > 0) && (constexprStrcmp(name_index[i - 1].name, name_index[i].name) >= 0)) {
+         return false;
+      }
+      if(constexprStrcmp(keycode_table[name_index[i].keycode].name, name_index[i].name) != 0) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static_assert(isNameIndexValid(), 
+   "The key name index must be sorted and consistent with the keycode table");
+
+} // namespace
+
+int keycodeFromName(const char *name)
+{
+   auto end = name_index + n_names;
+   auto it = std::lower_bound(name_index, end, name,
+      [](const NameIndexEntry &entry, const char *n) {
+         return std::strcmp(entry.name, n) < 0;
+      });
+
+   if((it == end) || (std::strcmp(it->name, name) != 0)) {
+      return -1;
+   }
+
+   return it->keycode;
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,56 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief Metadata of a HID keyboard keycode.
+/// @details Strings are empty if not available for a keycode.
+///
+struct KeycodeInfo {
+   const char *label;       ///< A four character label used for keyboard visualization
+   const char *name;        ///< The Kaleidoscope key name without the Key_ prefix
+   const char *description; ///< A short description used to dump reports
+   uint16_t evdev_code;     ///< The Linux input event code (see linux/input-event-codes.h), 0 if none
+   bool is_modifier;
+};
+
+/// @brief Metadata of all HID keyboard keycodes, indexed by keycode.
+///
+extern const KeycodeInfo keycode_table[256];
+
+/// @brief Retreives the metadata of a keycode.
+/// @param keycode The HID keycode.
+///
+inline
+const KeycodeInfo &getKeycodeInfo(uint8_t keycode) {
+   return keycode_table[keycode];
+}
+
+/// @brief Determines a keycode by Kaleidoscope key name.
+/// @param name The key name without the Key_ prefix, e.g. "LeftShift".
+/// @returns The keycode or -1 if there is no key with the given name.
+///
+int keycodeFromName(const char *name);
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -0,0 +1,64 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Log levels. Messages of a level above the compile time threshold
+// KALEIDOSCOPE_SIMULATOR_LOG_LEVEL are compiled out completely.
+// For quiet test runs, build with e.g.
+//
+//    -DKALEIDOSCOPE_SIMULATOR_LOG_LEVEL=KALEIDOSCOPE_SIMULATOR_LOG_LEVEL_INFO
+//
+#define KALEIDOSCOPE_SIMULATOR_LOG_LEVEL_NONE  0
+#define KALEIDOSCOPE_SIMULATOR_LOG_LEVEL_INFO  1
+#define KALEIDOSCOPE_SIMULATOR_LOG_LEVEL_DEBUG 2
+#define KALEIDOSCOPE_SIMULATOR_LOG_LEVEL_TRACE 3
+
+#ifndef KALEIDOSCOPE_SIMULATOR_LOG_LEVEL
+#define KALEIDOSCOPE_SIMULATOR_LOG_LEVEL KALEIDOSCOPE_SIMULATOR_LOG_LEVEL_DEBUG
+#endif
+
+/// @brief Checks if messages of a log level are emitted by a simulator.
+/// @details Evaluates to a compile time constant false for levels above
+///        the compile time threshold. Otherwise, messages are only emitted
+///        if the simulator is not quiet.
+/// @param SIMULATOR The simulator.
+/// @param LEVEL The log level (INFO, DEBUG or TRACE).
+///
+#define KS_LOG_ENABLED(SIMULATOR, LEVEL)                                       \
+   ((KALEIDOSCOPE_SIMULATOR_LOG_LEVEL_##LEVEL                                  \
+                           <= KALEIDOSCOPE_SIMULATOR_LOG_LEVEL)                \
+      && !(SIMULATOR).isQuiet())
+
+/// @brief Writes a message to the log stream of a simulator if its log
+///        level is enabled (see KS_LOG_ENABLED).
+/// @details The message is only formatted if it is emitted.
+///
+///        @code
+///        KS_LOG(simulator, DEBUG, "Key " << row << ' ' << col << " pressed");
+///        @endcode
+///
+/// @param SIMULATOR The simulator.
+/// @param LEVEL The log level (INFO, DEBUG or TRACE).
+///
+#define KS_LOG(SIMULATOR, LEVEL, ...)                                          \
+   do {                                                                        \
+      if(KS_LOG_ENABLED(SIMULATOR, LEVEL)) {                                   \
+         (SIMULATOR).log() << __VA_ARGS__;                                     \
+      }                                                                        \
+   } while(false)
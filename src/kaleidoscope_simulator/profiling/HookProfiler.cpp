@@ -0,0 +1,174 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/profiling/HookProfiler.h"
+#include "papilio/Simulator.h"
+
+namespace kaleidoscope {
+namespace simulator {
+namespace profiling {
+
+void DurationStatistics::add(uint64_t duration_ns)
+{
+   ++n_samples_;
+   total_ += duration_ns;
+   if(duration_ns < min_) { min_ = duration_ns; }
+   if(duration_ns > max_) { max_ = duration_ns; }
+   ++bins_[binIndex(duration_ns)];
+}
+
+int DurationStatistics::binIndex(uint64_t duration_ns)
+{
+   if(duration_ns < n_linear_bins_) {
+      return static_cast<int>(duration_ns);
+   }
+
+   // Bins are grouped by the position of the most significant bit.
+   // Every group is split into n_sub_bins_ linear sub-bins.
+   //
+   int msb = 63 - __builtin_clzll(duration_ns);
+   int sub_bin = static_cast<int>((duration_ns >> (msb - 3)) & (n_sub_bins_ - 1));
+   int bin = n_linear_bins_ + (msb - 4)*n_sub_bins_ + sub_bin;
+
+   return (bin < n_bins_) ? bin : n_bins_ - 1;
+}
+
+uint64_t DurationStatistics::binUpperBound(int bin)
+{
+   if(bin < n_linear_bins_) {
+      return static_cast<uint64_t>(bin);
+   }
+
+   int msb = (bin - n_linear_bins_)/n_sub_bins_ + 4;
+   int sub_bin = (bin - n_linear_bins_)%n_sub_bins_;
+
+   return ((uint64_t(n_sub_bins_ + sub_bin + 1)) << (msb - 3)) - 1;
+}
+
+uint64_t DurationStatistics::getPercentile(double p) const
+{
+   if(n_samples_ == 0) { return 0; }
+
+   uint64_t threshold = static_cast<uint64_t>(p/100.0*n_samples_ + 0.5);
+   if(threshold < 1) { threshold = 1; }
+
+   uint64_t accumulated = 0;
+   for(int bin = 0; bin < n_bins_; ++bin) {
+      accumulated += bins_[bin];
+      if(accumulated >= threshold) {
+         auto upper = binUpperBound(bin);
+         return (upper < max_) ? upper : max_;
+      }
+   }
+
+   return max_;
+}
+
+const char *hookName(Hook hook)
+{
+   switch(hook) {
+      case Hook::onSetup: return "onSetup";
+      case Hook::beforeEachCycle: return "beforeEachCycle";
+      case Hook::onKeyswitchEvent: return "onKeyswitchEvent";
+      case Hook::beforeReportingState: return "beforeReportingState";
+      case Hook::afterEachCycle: return "afterEachCycle";
+      case Hook::onLayerChange: return "onLayerChange";
+      case Hook::onLEDModeChange: return "onLEDModeChange";
+      case Hook::beforeSyncingLeds: return "beforeSyncingLeds";
+      case Hook::onFocusEvent: return "onFocusEvent";
+      case Hook::onNameQuery: return "onNameQuery";
+      case Hook::n_hooks: break;
+   }
+   return "";
+}
+
+HookProfiler &HookProfiler::getInstance()
+{
+   static HookProfiler profiler;
+   return profiler;
+}
+
+int HookProfiler::registerPlugin(const char *name)
+{
+   plugins_.emplace_back();
+   plugins_.back().name = name;
+   return static_cast<int>(plugins_.size()) - 1;
+}
+
+void HookProfiler::endCycle(uint64_t duration_ns)
+{
+   cycles_.add(duration_ns);
+
+   for(auto &plugin: plugins_) {
+      plugin.per_cycle.add(plugin.cycle_time);
+      plugin.cycle_time = 0;
+   }
+}
+
+void HookProfiler::reset()
+{
+   for(auto &plugin: plugins_) {
+      for(auto &hook: plugin.hooks) {
+         hook = DurationStatistics{};
+      }
+      plugin.per_cycle = DurationStatistics{};
+      plugin.cycle_time = 0;
+   }
+   cycles_ = DurationStatistics{};
+}
+
+namespace {
+
+template<typename _Stream>
+void dumpStatistics(_Stream &&out, const DurationStatistics &stats)
+{
+   out << "calls: " << stats.getNumSamples()
+       << ", total [us]: " << stats.getTotal()/1000.0
+       << ", mean [ns]: " << stats.getMean()
+       << ", min [ns]: " << stats.getMin()
+       << ", max [ns]: " << stats.getMax()
+       << ", p50 [ns]: " << stats.getPercentile(50)
+       << ", p90 [ns]: " << stats.getPercentile(90)
+       << ", p99 [ns]: " << stats.getPercentile(99);
+}
+
+} // namespace
+
+void HookProfiler::dump(const papilio::Simulator &simulator) const
+{
+   if(!this->isActive()) { return; }
+
+   simulator.log() << "Plugin hook profile";
+   dumpStatistics(simulator.log() << "   scan cycle: ", cycles_);
+
+   for(const auto &plugin: plugins_) {
+      dumpStatistics(simulator.log() << "   " << plugin.name << " per cycle: ",
+                     plugin.per_cycle);
+
+      for(int hook = 0; hook < static_cast<int>(Hook::n_hooks); ++hook) {
+         const auto &stats = plugin.hooks[hook];
+         if(stats.getNumSamples() == 0) { continue; }
+         dumpStatistics(simulator.log() << "      " << hookName(static_cast<Hook>(hook)) << ": ",
+                        stats);
+      }
+   }
+}
+
+} // namespace profiling
+} // namespace simulator
+} // namespace kaleidoscope
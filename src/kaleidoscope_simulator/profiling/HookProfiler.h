@@ -0,0 +1,207 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace papilio {
+class Simulator;
+} // namespace papilio
+
+namespace kaleidoscope {
+namespace simulator {
+namespace profiling {
+
+/// @brief Duration statistics.
+/// @details Percentiles are computed from a log-linear histogram
+///        with a relative resolution of 12.5%. Memory consumption
+///        is therefore independent of the number of samples.
+///
+class DurationStatistics
+{
+   public:
+
+      /// @brief Adds a sample.
+      /// @param duration_ns The duration [ns].
+      ///
+      void add(uint64_t duration_ns);
+
+      uint64_t getNumSamples() const { return n_samples_; }
+      uint64_t getTotal() const { return total_; }
+      uint64_t getMin() const { return (n_samples_ > 0) ? min_ : 0; }
+      uint64_t getMax() const { return max_; }
+      double getMean() const {
+         return (n_samples_ > 0) ? double(total_)/n_samples_ : 0.0;
+      }
+
+      /// @brief Computes an approximate percentile.
+      /// @param p The percentile in the range [0, 100].
+      /// @returns The upper bound of the histogram bin the percentile
+      ///        falls into [ns].
+      ///
+      uint64_t getPercentile(double p) const;
+
+   private:
+
+      static constexpr int n_linear_bins_ = 16;
+      static constexpr int n_sub_bins_ = 8;
+      static constexpr int n_bins_ = n_linear_bins_ + 60*n_sub_bins_;
+
+      static int binIndex(uint64_t duration_ns);
+      static uint64_t binUpperBound(int bin);
+
+   private:
+
+      uint64_t n_samples_ = 0;
+      uint64_t total_ = 0;
+      uint64_t min_ = UINT64_MAX;
+      uint64_t max_ = 0;
+      uint32_t bins_[n_bins_] = {};
+};
+
+/// @brief The hooks that can be profiled.
+///
+enum class Hook : uint8_t {
+   onSetup,
+   beforeEachCycle,
+   onKeyswitchEvent,
+   beforeReportingState,
+   afterEachCycle,
+   onLayerChange,
+   onLEDModeChange,
+   beforeSyncingLeds,
+   onFocusEvent,
+   onNameQuery,
+   n_hooks
+};
+
+/// @brief Retreives the name of a hook.
+///
+const char *hookName(Hook hook);
+
+/// @brief Collects timing statistics of plugin hooks.
+/// @details Plugins are profiled by wrapping them
+///        (see KALEIDOSCOPE_SIMULATOR_PROFILED_PLUGIN). Timing of every
+///        hook call is recorded. Additionally, the accumulated time
+///        every plugin spends per scan cycle and the duration of
+///        the complete scan cycle are recorded.
+///
+class HookProfiler
+{
+   public:
+
+      typedef std::chrono::steady_clock Clock;
+
+      /// @brief Access the profiler singleton.
+      ///
+      static HookProfiler &getInstance();
+
+      /// @brief Registers a plugin for profiling.
+      /// @param name The plugin name.
+      /// @returns A plugin id.
+      ///
+      int registerPlugin(const char *name);
+
+      /// @brief Records a hook call.
+      /// @param plugin_id The id of the plugin.
+      /// @param hook The hook that was called.
+      /// @param duration_ns The hook's run time [ns].
+      ///
+      void recordHook(int plugin_id, Hook hook, uint64_t duration_ns) {
+         auto &plugin = plugins_[plugin_id];
+         plugin.hooks[static_cast<int>(hook)].add(duration_ns);
+         plugin.cycle_time += duration_ns;
+      }
+
+      /// @brief Retreives the statistics of a plugin's hook.
+      /// @param plugin_id The id of the plugin.
+      /// @param hook The hook.
+      ///
+      const DurationStatistics &getHookStatistics(int plugin_id, Hook hook) const {
+         return plugins_[plugin_id].hooks[static_cast<int>(hook)];
+      }
+
+      /// @brief Checks if any plugin is profiled.
+      ///
+      bool isActive() const { return !plugins_.empty(); }
+
+      /// @brief Marks the end of a scan cycle.
+      /// @param duration_ns The duration of the complete scan cycle [ns].
+      ///
+      void endCycle(uint64_t duration_ns);
+
+      /// @brief Writes the statistics to a simulator's log.
+      /// @param simulator The simulator whose log is used.
+      ///
+      void dump(const papilio::Simulator &simulator) const;
+
+      /// @brief Discards all recorded statistics.
+      ///
+      void reset();
+
+   private:
+
+      HookProfiler() {}
+
+      struct PluginStatistics {
+         std::string name;
+         DurationStatistics hooks[static_cast<int>(Hook::n_hooks)];
+         DurationStatistics per_cycle;
+         uint64_t cycle_time = 0;
+      };
+
+   private:
+
+      std::vector<PluginStatistics> plugins_;
+      DurationStatistics cycles_;
+};
+
+/// @brief A scope guard that records the run time of a hook.
+/// @private
+///
+class HookTimer
+{
+   public:
+
+      HookTimer(int plugin_id, Hook hook)
+         :  plugin_id_(plugin_id),
+            hook_(hook),
+            start_(HookProfiler::Clock::now())
+      {}
+
+      ~HookTimer() {
+         auto end = HookProfiler::Clock::now();
+         HookProfiler::getInstance().recordHook(plugin_id_, hook_,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count());
+      }
+
+   private:
+
+      int plugin_id_;
+      Hook hook_;
+      HookProfiler::Clock::time_point start_;
+};
+
+} // namespace profiling
+} // namespace simulator
+} // namespace kaleidoscope
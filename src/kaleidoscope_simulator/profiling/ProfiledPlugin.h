@@ -0,0 +1,243 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/profiling/HookProfiler.h"
+
+#include "Kaleidoscope.h"
+
+#include <type_traits>
+
+namespace kaleidoscope {
+namespace simulator {
+namespace profiling {
+
+/// @private
+/// @brief Determines the class that defines a hook.
+/// @details Overloaded hooks are resolved by their argument types.
+/// @tparam _Args The argument types of the hook.
+///
+template<typename... _Args>
+struct HookDefinition {
+   template<typename _Class>
+   static _Class getClass(kaleidoscope::EventHandlerResult (_Class::*)(_Args...));
+};
+
+/// @private
+/// @brief Checks if a hook is defined by a plugin rather than inherited
+///        from kaleidoscope::Plugin.
+/// @tparam _Class The class that defines the hook (see HookDefinition).
+///
+template<typename _Class>
+using OverridesHook = std::integral_constant<bool, 
+   !std::is_same<_Class, kaleidoscope::Plugin>::value>;
+
+/// @brief A plugin wrapper that times the hooks of the wrapped plugin.
+/// @details Hook calls are forwarded to the wrapped plugin. Only hooks 
+///        that the wrapped plugin overrides are timed. All other hooks 
+///        are handled by the empty defaults of kaleidoscope::Plugin, 
+///        exactly as for the unwrapped plugin, and don't appear in the
+///        statistics. Every forwarding method is only instantiated if 
+///        Kaleidoscope's hook dispatcher actually calls it. Use the wrapper
+///        instead of the original plugin in KALEIDOSCOPE_INIT_PLUGINS(...).
+///        The original plugin object remains the one to configure.
+///
+template<typename _Plugin>
+class ProfiledPlugin : public kaleidoscope::Plugin
+{
+   public:
+
+      /// @brief Constructor.
+      /// @param plugin The plugin to profile.
+      /// @param name The name that is used to report statistics.
+      ///
+      ProfiledPlugin(_Plugin &plugin, const char *name)
+         :  plugin_(plugin),
+            plugin_id_(HookProfiler::getInstance().registerPlugin(name))
+      {}
+      
+      /// @brief Retreives the id the plugin is registered with 
+      ///        at the HookProfiler.
+      ///
+      int getPluginId() const { return plugin_id_; }
+      
+      /// @brief Checks if the wrapped plugin overrides a hook.
+      /// @details Only hooks that are overridden are timed.
+      /// @param hook The hook.
+      ///
+      static bool overrides(Hook hook) {
+         switch(hook) {
+            case Hook::onSetup: 
+               return OverridesOnSetup::value;
+            case Hook::beforeEachCycle: 
+               return OverridesBeforeEachCycle::value;
+            case Hook::onKeyswitchEvent: 
+               return OverridesOnKeyswitchEvent::value;
+            case Hook::beforeReportingState: 
+               return OverridesBeforeReportingState::value;
+            case Hook::afterEachCycle: 
+               return OverridesAfterEachCycle::value;
+            case Hook::onLayerChange: 
+               return OverridesOnLayerChange::value;
+            case Hook::onLEDModeChange: 
+               return OverridesOnLEDModeChange::value;
+            case Hook::beforeSyncingLeds: 
+               return OverridesBeforeSyncingLeds::value;
+            case Hook::onFocusEvent: 
+               return OverridesOnFocusEvent::value;
+            case Hook::onNameQuery: 
+               return OverridesOnNameQuery::value;
+            case Hook::n_hooks: 
+               break;
+         }
+         return false;
+      }
+
+      kaleidoscope::EventHandlerResult onSetup() {
+         return this->forward(Hook::onSetup, 
+            OverridesOnSetup{},
+            [this]() { return plugin_.onSetup(); });
+      }
+
+      kaleidoscope::EventHandlerResult beforeEachCycle() {
+         return this->forward(Hook::beforeEachCycle, 
+            OverridesBeforeEachCycle{},
+            [this]() { return plugin_.beforeEachCycle(); });
+      }
+
+      kaleidoscope::EventHandlerResult onKeyswitchEvent(Key &mappedKey,
+                                                        KeyAddr key_addr,
+                                                        uint8_t keyState) {
+         return this->forward(Hook::onKeyswitchEvent, 
+            OverridesOnKeyswitchEvent{},
+            [&]() { return plugin_.onKeyswitchEvent(mappedKey, key_addr, keyState); });
+      }
+
+      kaleidoscope::EventHandlerResult beforeReportingState() {
+         return this->forward(Hook::beforeReportingState, 
+            OverridesBeforeReportingState{},
+            [this]() { return plugin_.beforeReportingState(); });
+      }
+
+      kaleidoscope::EventHandlerResult afterEachCycle() {
+         return this->forward(Hook::afterEachCycle, 
+            OverridesAfterEachCycle{},
+            [this]() { return plugin_.afterEachCycle(); });
+      }
+
+      kaleidoscope::EventHandlerResult onLayerChange() {
+         return this->forward(Hook::onLayerChange, 
+            OverridesOnLayerChange{},
+            [this]() { return plugin_.onLayerChange(); });
+      }
+
+      kaleidoscope::EventHandlerResult onLEDModeChange() {
+         return this->forward(Hook::onLEDModeChange, 
+            OverridesOnLEDModeChange{},
+            [this]() { return plugin_.onLEDModeChange(); });
+      }
+
+      kaleidoscope::EventHandlerResult beforeSyncingLeds() {
+         return this->forward(Hook::beforeSyncingLeds, 
+            OverridesBeforeSyncingLeds{},
+            [this]() { return plugin_.beforeSyncingLeds(); });
+      }
+
+      kaleidoscope::EventHandlerResult onFocusEvent(const char *command) {
+         return this->forward(Hook::onFocusEvent, 
+            OverridesOnFocusEvent{},
+            [&]() { return plugin_.onFocusEvent(command); });
+      }
+
+      kaleidoscope::EventHandlerResult onNameQuery() {
+         return this->forward(Hook::onNameQuery, 
+            OverridesOnNameQuery{},
+            [this]() { return plugin_.onNameQuery(); });
+      }
+
+      // Sketch exploration happens at compile time. There is nothing to time.
+      //
+      template<typename _Sketch>
+      kaleidoscope::EventHandlerResult exploreSketch() {
+         return plugin_.template exploreSketch<_Sketch>();
+      }
+      
+   private:
+      
+      // Whether the wrapped plugin overrides the hooks.
+      //
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::onSetup))> OverridesOnSetup;
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::beforeEachCycle))> OverridesBeforeEachCycle;
+      typedef OverridesHook<decltype(
+         HookDefinition<Key &, KeyAddr, uint8_t>::getClass(&_Plugin::onKeyswitchEvent))> OverridesOnKeyswitchEvent;
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::beforeReportingState))> OverridesBeforeReportingState;
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::afterEachCycle))> OverridesAfterEachCycle;
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::onLayerChange))> OverridesOnLayerChange;
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::onLEDModeChange))> OverridesOnLEDModeChange;
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::beforeSyncingLeds))> OverridesBeforeSyncingLeds;
+      typedef OverridesHook<decltype(
+         HookDefinition<const char *>::getClass(&_Plugin::onFocusEvent))> OverridesOnFocusEvent;
+      typedef OverridesHook<decltype(
+         HookDefinition<>::getClass(&_Plugin::onNameQuery))> OverridesOnNameQuery;
+      
+      template<typename _Call>
+      kaleidoscope::EventHandlerResult forward(Hook hook, 
+                                               std::true_type /* overridden */,
+                                               _Call &&call) {
+         HookTimer timer(plugin_id_, hook);
+         return call();
+      }
+      
+      // Hooks that are not overridden are not timed. Timing the empty 
+      // default would only measure the profiler's own overhead.
+      //
+      template<typename _Call>
+      kaleidoscope::EventHandlerResult forward(Hook, 
+                                               std::false_type /* overridden */,
+                                               _Call &&call) {
+         return call();
+      }
+
+   private:
+
+      _Plugin &plugin_;
+      int plugin_id_;
+};
+
+} // namespace profiling
+} // namespace simulator
+} // namespace kaleidoscope
+
+/// @brief Defines a profiled version of a plugin.
+/// @details The macro must be invoked at global scope of the sketch,
+///        after the plugin has been declared. It defines an object
+///        PLUGIN##_profiled that must be passed to KALEIDOSCOPE_INIT_PLUGINS(...)
+///        instead of the plugin itself.
+/// @param PLUGIN The plugin object.
+///
+#define KALEIDOSCOPE_SIMULATOR_PROFILED_PLUGIN(PLUGIN)                         \
+   kaleidoscope::simulator::profiling::ProfiledPlugin<decltype(PLUGIN)>        \
+      PLUGIN##_profiled(PLUGIN, #PLUGIN);
@@ -21,6 +21,8 @@
 
 namespace kaleidoscope {
 namespace simulator {
+
+const char AbsoluteMouseReport::type_string_[] = "absolute mouse";
    
    AbsoluteMouseReport::AbsoluteMouseReport()
    :  report_data_{}
@@ -51,17 +53,18 @@ AbsoluteMouseReport &AbsoluteMouseReport::operator=(const AbsoluteMouseReport &o
 
 std::shared_ptr<papilio::Report_> AbsoluteMouseReport::clone() const
 {
-   return std::shared_ptr<papilio::Report_>{ new AbsoluteMouseReport{*this} };
+   return makePooled<AbsoluteMouseReport>(*this);
 }
 
 bool AbsoluteMouseReport::equals(const papilio::Report_ &other) const
 {
-   const AbsoluteMouseReport *other_amr =
-      dynamic_cast<const AbsoluteMouseReport *>(&other);
-      
-   if(!other_amr) { return false; }
+   // Report types are identified by the address of their type string.
+   //
+   if(other.getTypeString() != type_string_) { return false; }
+   
+   const AbsoluteMouseReport &other_amr = static_cast<const AbsoluteMouseReport &>(other);
    
-   return memcmp(&report_data_, &other_amr->report_data_, sizeof(report_data_)) == 0;
+   return memcmp(&report_data_, &other_amr.report_data_, sizeof(report_data_)) == 0;
 }
 
 bool AbsoluteMouseReport::areButtonsPressed(uint8_t button_state) const
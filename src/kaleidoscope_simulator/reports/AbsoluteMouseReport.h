@@ -19,6 +19,7 @@
 #pragma once
 
 #include "DeviceAPIs/AbsoluteMouseAPI.h"
+#include "kaleidoscope_simulator/aux/ReportPool.h"
 #include "papilio/reports/AbsoluteMouseReport_.h"
 
 // Undefine some macros defined by Arduino
@@ -43,6 +44,8 @@ class AbsoluteMouseReport : public papilio::AbsoluteMouseReport_ {
       
       typedef HID_MouseAbsoluteReport_Data_t ReportDataType;
       
+      static constexpr uint8_t hid_report_type_ = HID_REPORTID_MOUSE_ABSOLUTE;
+      
       static constexpr uint16_t max_x_coordinate = 32767;
       static constexpr uint16_t max_y_coordinate = 32767;
       
@@ -64,9 +67,7 @@ class AbsoluteMouseReport : public papilio::AbsoluteMouseReport_ {
       
       template<typename..._Args>
       static std::shared_ptr<AbsoluteMouseReport> create(_Args &&... args) {
-         return std::shared_ptr<AbsoluteMouseReport>{
-            new AbsoluteMouseReport{std::forward<_Args>(args)...}
-         };
+         return makePooled<AbsoluteMouseReport>(std::forward<_Args>(args)...);
       }
       
       AbsoluteMouseReport &operator=(const AbsoluteMouseReport &other);
@@ -139,11 +140,18 @@ class AbsoluteMouseReport : public papilio::AbsoluteMouseReport_ {
       
       const ReportDataType& getReportData() const { return report_data_; }
       
-      static const char *typeString() { return "absolute mouse"; }
+      /// @brief The report type string.
+      /// @details Every report class has its own string object. Reports
+      ///        are therefore of the same type if and only if the addresses
+      ///        of their type strings match.
+      ///
+      static const char *typeString() { return type_string_; }
       virtual const char *getTypeString() const override { return typeString(); }
       
    private:
    
+      static const char type_string_[];
+      
       ReportDataType report_data_;
 };
 
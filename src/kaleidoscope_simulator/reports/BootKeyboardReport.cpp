@@ -24,6 +24,7 @@
 
 #include "kaleidoscope_simulator/reports/BootKeyboardReport.h"
 #include "kaleidoscope_simulator/aux/exceptions.h"
+#include "kaleidoscope_simulator/aux/keycodes.h"
 #include "papilio/Simulator.h"
 #include "papilio/SimulatorCore_.h"
 #include "MultiReport/Keyboard.h"
@@ -33,6 +34,8 @@
 namespace kaleidoscope {
 namespace simulator {
 
+const char BootKeyboardReport::type_string_[] = "keyboard";
+
    BootKeyboardReport
       ::BootKeyboardReport()
    :  report_data_{}
@@ -56,19 +59,20 @@ namespace simulator {
 
 std::shared_ptr<papilio::Report_> BootKeyboardReport::clone() const
 {
-   return std::shared_ptr<papilio::Report_>{ new BootKeyboardReport{*this} };
+   return makePooled<BootKeyboardReport>(*this);
 }
 
 bool 
    BootKeyboardReport
       ::equals(const papilio::Report_ &other) const
-{   
-   const BootKeyboardReport *other_bkr =
-      dynamic_cast<const BootKeyboardReport *>(&other);
-      
-   if(!other_bkr) { return false; }
+{
+   // Report types are identified by the address of their type string.
+   //
+   if(other.getTypeString() != type_string_) { return false; }
+   
+   const BootKeyboardReport &other_bkr = static_cast<const BootKeyboardReport &>(other);
    
-   return memcmp(&report_data_, &other_bkr->report_data_, sizeof(report_data_)) == 0;
+   return memcmp(&report_data_, &other_bkr.report_data_, sizeof(report_data_)) == 0;
 }
       
 bool 
@@ -98,6 +102,20 @@ std::vector<uint8_t>
    return active_keycodes;
 }
 
+KeycodeBitset
+   BootKeyboardReport
+      ::getActiveKeycodeBitset() const
+{
+   KeycodeBitset keycodes;
+   for(int i = 0; i < 6; ++i) {
+      if(report_data_.keycodes[i] != 0) {
+         keycodes.set(report_data_.keycodes[i]);
+      }
+   }
+   keycodes.assignBytes(&report_data_.modifiers, 1, HID_KEYBOARD_FIRST_MODIFIER/8);
+   return keycodes;
+}
+
 bool   
    BootKeyboardReport
       ::isAnyKeyActive() const
@@ -167,16 +185,6 @@ void
    memcpy(&report_data_, &report_data, sizeof(report_data_));
 }
 
-// For each bit set in 'bitfield', output the corresponding string to 'stream'
-#define FOREACHBIT(bitfield, stream, str0, str1, str2, str3, str4, str5, str6, str7) \
-  if((bitfield) & 1<<0) stream << str0; \
-  if((bitfield) & 1<<1) stream << str1; \
-  if((bitfield) & 1<<2) stream << str2; \
-  if((bitfield) & 1<<3) stream << str3; \
-  if((bitfield) & 1<<4) stream << str4; \
-  if((bitfield) & 1<<5) stream << str5; \
-  if((bitfield) & 1<<6) stream << str6; \
-  if((bitfield) & 1<<7) stream << str7;
 void
    BootKeyboardReport
       ::dump(const papilio::Simulator &simulator, const char *add_indent) const
@@ -202,13 +210,15 @@ void
       out << add_indent << "<none>";
    } else {
       out << add_indent;
-      FOREACHBIT(report_data_.modifiers, out,
-        "lctrl ", "lshift ", "lalt ", "lgui ",
-        "rctrl ", "rshift ", "ralt ", "rgui ")
+      for(uint8_t m = 0; m < 8; ++m) {
+         if(report_data_.modifiers & (1 << m)) {
+            out << getKeycodeInfo(HID_KEYBOARD_FIRST_MODIFIER + m).description << ' ';
+         }
+      }
 
       for(int i = 0; i < 6; ++i) {
          if(report_data_.keycodes[i] != 0) {
-            out << simulator.getCore().keycodeToName(report_data_.keycodes[i]) << ' ';
+            out << getKeycodeInfo(report_data_.keycodes[i]).name << ' ';
          }
       }
    }
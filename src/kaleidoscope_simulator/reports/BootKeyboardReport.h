@@ -19,6 +19,8 @@
 #pragma once
 
 #include "kaleidoscope/key_defs.h"
+#include "kaleidoscope_simulator/aux/Bitset.h"
+#include "kaleidoscope_simulator/aux/ReportPool.h"
 #include "papilio/reports/BootKeyboardReport_.h"
 #include "BootKeyboard/BootKeyboard.h"
 
@@ -64,9 +66,7 @@ class BootKeyboardReport : public papilio::BootKeyboardReport_ {
       
       template<typename..._Args>
       static std::shared_ptr<BootKeyboardReport> create(_Args &&... args) {
-         return std::shared_ptr<BootKeyboardReport>{
-            new BootKeyboardReport{std::forward<_Args>(args)...}
-         };
+         return makePooled<BootKeyboardReport>(std::forward<_Args>(args)...);
       }
       
       virtual std::shared_ptr<papilio::Report_> clone() const override;
@@ -114,6 +114,11 @@ class BootKeyboardReport : public papilio::BootKeyboardReport_ {
       /// @details Empty means neither key nor modifier keycodes are active.
       ///
       virtual bool isEmpty() const override;
+
+      /// @brief Retreives the set of all active keycodes, including
+      ///        modifier keycodes.
+      ///
+      KeycodeBitset getActiveKeycodeBitset() const;
       
       /// @brief Writes a formatted representation of the keyboard report 
       ///        to the simulator's log stream.
@@ -128,11 +133,18 @@ class BootKeyboardReport : public papilio::BootKeyboardReport_ {
       
       const ReportDataType& getReportData() const { return report_data_; }
       
-      static const char *typeString() { return "keyboard"; }
+      /// @brief The report type string.
+      /// @details Every report class has its own string object. Reports
+      ///        are therefore of the same type if and only if the addresses
+      ///        of their type strings match.
+      ///
+      static const char *typeString() { return type_string_; }
       virtual const char *getTypeString() const override { return typeString(); }
       
    private:
    
+      static const char type_string_[];
+      
       ReportDataType report_data_;
 };
 
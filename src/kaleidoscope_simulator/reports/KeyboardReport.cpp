@@ -24,6 +24,7 @@
 
 #include "kaleidoscope_simulator/reports/KeyboardReport.h"
 #include "kaleidoscope_simulator/aux/exceptions.h"
+#include "kaleidoscope_simulator/aux/keycodes.h"
 #include "papilio/Simulator.h"
 
 #include <vector>
@@ -31,6 +32,8 @@
 namespace kaleidoscope {
 namespace simulator {
 
+const char KeyboardReport::type_string_[] = "keyboard";
+
    KeyboardReport
       ::KeyboardReport()
    :  report_data_{}
@@ -54,19 +57,20 @@ namespace simulator {
 
 std::shared_ptr<papilio::Report_> KeyboardReport::clone() const
 {
-   return std::shared_ptr<papilio::Report_>{ new KeyboardReport{*this} };
+   return makePooled<KeyboardReport>(*this);
 }
       
 bool 
    KeyboardReport
       ::equals(const papilio::Report_ &other) const
 {
-   const KeyboardReport *other_kr =
-      dynamic_cast<const KeyboardReport *>(&other);
-      
-   if(!other_kr) { return false; }
+   // Report types are identified by the address of their type string.
+   //
+   if(other.getTypeString() != type_string_) { return false; }
+   
+   const KeyboardReport &other_kr = static_cast<const KeyboardReport &>(other);
    
-   return memcmp(&report_data_, &other_kr->report_data_, sizeof(report_data_)) == 0;
+   return memcmp(&report_data_, &other_kr.report_data_, sizeof(report_data_)) == 0;
 }
       
 bool 
@@ -83,19 +87,44 @@ bool
    return false;
 }
 
+namespace {
+   
+// Keycodes beyond HID_LAST_KEY that fit into the key bytes are unused.
+//
+KeycodeBitset keyBitset(const KeyboardReport::ReportDataType &report_data)
+{
+   KeycodeBitset keys;
+   keys.assignBytes(report_data.keys, KEY_BYTES);
+   for(size_t k = HID_LAST_KEY + 1; k < 8*KEY_BYTES; ++k) {
+      keys.reset(k);
+   }
+   return keys;
+}
+
+} // namespace
+
+KeycodeBitset
+   KeyboardReport
+      ::getActiveKeycodeBitset() const
+{
+   KeycodeBitset keycodes = keyBitset(report_data_);
+   keycodes.assignBytes(&report_data_.modifiers, 1, HID_KEYBOARD_FIRST_MODIFIER/8);
+   return keycodes;
+}
+
 std::vector<uint8_t>
    KeyboardReport
       ::getActiveKeycodes() const
 {
+   KeycodeBitset keys = keyBitset(report_data_);
+   
    std::vector<uint8_t> activeKeys;
+   activeKeys.reserve(keys.count());
+   
+   keys.forEach([&activeKeys](size_t k) {
+      activeKeys.push_back(static_cast<uint8_t>(k));
+   });
    
-   for(uint8_t k = 0; k <= HID_LAST_KEY; ++k) {
-      uint8_t bit = 1 << (uint8_t(k) % 8);
-      uint8_t keyCode = report_data_.keys[k / 8] & bit;
-      if(keyCode) {
-         activeKeys.push_back(k);
-      }
-   }
    return activeKeys;
 }
 
@@ -103,14 +132,7 @@ bool
    KeyboardReport
       ::isAnyKeyActive() const
 {
-   for(int k = 0; k <= HID_LAST_KEY; ++k) {
-      uint8_t bit = 1 << (uint8_t(k) % 8);
-      if(report_data_.keys[k / 8] & bit) {
-         return true;
-      }
-   }
-   
-   return false;
+   return keyBitset(report_data_).any();
 }
       
 bool
@@ -131,13 +153,7 @@ bool
    KeyboardReport
       ::isAssertAnyModifierActive() const
 {
-   for(uint8_t k = HID_KEYBOARD_FIRST_MODIFIER; k <= HID_KEYBOARD_LAST_MODIFIER; ++k) {
-      uint8_t kTmp = k - HID_KEYBOARD_FIRST_MODIFIER;
-      if(!!(report_data_.modifiers & (1 << kTmp))) {
-         return true;
-      }
-   }
-   return false;
+   return report_data_.modifiers != 0;
 }
 
 std::vector<uint8_t> 
@@ -145,12 +161,10 @@ std::vector<uint8_t>
       ::getActiveModifiers() const
 {
    std::vector<uint8_t> activeModifiers;
+   activeModifiers.reserve(__builtin_popcount(report_data_.modifiers));
    
-   for(uint8_t k = HID_KEYBOARD_FIRST_MODIFIER; k <= HID_KEYBOARD_LAST_MODIFIER; ++k) {
-      uint8_t kTmp = k - HID_KEYBOARD_FIRST_MODIFIER;
-      if(!!(report_data_.modifiers & (1 << kTmp))) {
-         activeModifiers.push_back(k);
-      }
+   for(unsigned bits = report_data_.modifiers; bits; bits &= bits - 1) {
+      activeModifiers.push_back(HID_KEYBOARD_FIRST_MODIFIER + __builtin_ctz(bits));
    }
    return activeModifiers;
 }
@@ -169,17 +183,6 @@ void
    memcpy(&report_data_, &report_data, sizeof(report_data_));
 }
 
-// For each bit set in 'bitfield', output the corresponding string to 'stream'
-#define FOREACHBIT(bitfield, stream, str0, str1, str2, str3, str4, str5, str6, str7) \
-  if((bitfield) & 1<<0) stream << str0; \
-  if((bitfield) & 1<<1) stream << str1; \
-  if((bitfield) & 1<<2) stream << str2; \
-  if((bitfield) & 1<<3) stream << str3; \
-  if((bitfield) & 1<<4) stream << str4; \
-  if((bitfield) & 1<<5) stream << str5; \
-  if((bitfield) & 1<<6) stream << str6; \
-  if((bitfield) & 1<<7) stream << str7;
-  
 void
    KeyboardReport
       ::dump(const papilio::Simulator &simulator, const char *add_indent) const
@@ -192,58 +195,35 @@ void
   out << "Keyboard report content:";
   if(!anything) {
     out << add_indent << "<none>";
-  } else {
-     out << add_indent;
-    FOREACHBIT(report_data_.modifiers, out,
-        "lctrl ", "lshift ", "lalt ", "lgui ",
-        "rctrl ", "rshift ", "ralt ", "rgui ")
-    FOREACHBIT(report_data_.keys[0], out,
-        "NO_EVENT ", "ERROR_ROLLOVER ", "POST_FAIL ", "ERROR_UNDEFINED ",
-        "a ", "b ", "c ", "d ")
-    FOREACHBIT(report_data_.keys[1], out,
-        "e ", "f ", "g ", "h ", "i ", "j ", "k ", "l ")
-    FOREACHBIT(report_data_.keys[2], out,
-        "m ", "n ", "o ", "p ", "q ", "r ", "s ", "t ")
-    FOREACHBIT(report_data_.keys[3], out,
-        "u ", "v ", "w ", "x ", "y ", "z ", "1/! ", "2/@ ")
-    FOREACHBIT(report_data_.keys[4], out,
-        "3/# ", "4/$ ", "5/% ", "6/^ ", "7/& ", "8/* ", "9/( ", "0/) ")
-    FOREACHBIT(report_data_.keys[5], out,
-        "enter ", "esc ", "del/bksp ", "tab ",
-        "space ", "-/_ ", "=/+ ", "[/{ ")
-    FOREACHBIT(report_data_.keys[6], out,
-        "]/} ", "\\/| ", "#/~ ", ";/: ", "'/\" ", "`/~ ", ",/< ", "./> ")
-    FOREACHBIT(report_data_.keys[7], out,
-        "//? ", "capslock ", "F1 ", "F2 ", "F3 ", "F4 ", "F5 ", "F6 ")
-    FOREACHBIT(report_data_.keys[8], out,
-        "F7 ", "F8 ", "F9 ", "F10 ", "F11 ", "F12 ", "prtscr ", "scrolllock ")
-    FOREACHBIT(report_data_.keys[9], out,
-        "pause ", "ins ", "home ", "pgup ", "del ", "end ", "pgdn ", "r_arrow ")
-    FOREACHBIT(report_data_.keys[10], out,
-        "l_arrow ", "d_arrow ", "u_arrow ", "numlock ",
-        "num/ ", "num* ", "num- ", "num+ ")
-    FOREACHBIT(report_data_.keys[11], out,
-        "numenter ", "num1 ", "num2 ", "num3 ",
-        "num4 ", "num5 ", "num6 ", "num7 ")
-    FOREACHBIT(report_data_.keys[12], out,
-        "num8 ", "num9 ", "num0 ", "num. ", "\\/| ", "app ", "power ", "num= ")
-    FOREACHBIT(report_data_.keys[13], out,
-        "F13 ", "F14 ", "F15 ", "F16 ", "F17 ", "F18 ", "F19 ", "F20 ")
-    FOREACHBIT(report_data_.keys[14], out,
-        "F21 ", "F22 ", "F23 ", "F24 ", "exec ", "help ", "menu ", "sel ")
-    FOREACHBIT(report_data_.keys[15], out,
-        "stop ", "again ", "undo ", "cut ", "copy ", "paste ", "find ", "mute ")
-    FOREACHBIT(report_data_.keys[16], out,
-        "volup ", "voldn ", "capslock_l ", "numlock_l ",
-        "scrolllock_l ", "num, ", "num= ", "(other) ")
-    for(int i = 17; i < KEY_BYTES; i++) {
-      // A little imprecise, in two ways:
-      //   (1) obviously, "(other)" refers to many distinct keys
-      //   (2) this might undercount the number of "other" keys pressed
-      // Therefore, if any keys are frequently used, they should be handled above and not via "other"
-      if(report_data_.keys[i]) out << "(other) ";
+    return;
+  }
+  
+  out << add_indent;
+  
+  for(uint8_t m = 0; m < 8; ++m) {
+    if(report_data_.modifiers & (1 << m)) {
+      out << getKeycodeInfo(HID_KEYBOARD_FIRST_MODIFIER + m).description << " ";
     }
   }
+  
+  // Keycodes without description are summarized as "(other)".
+  //
+  bool other = false;
+  
+  for(int i = 0; i < KEY_BYTES; i++) {
+    for(uint8_t bits = report_data_.keys[i]; bits; bits &= bits - 1) {
+      const char *description 
+        = getKeycodeInfo(static_cast<uint8_t>(8*i + __builtin_ctz(bits))).description;
+      if(*description) {
+        out << description << " ";
+      }
+      else {
+        other = true;
+      }
+    }
+  }
+  
+  if(other) out << "(other) ";
 }
 
 } // namespace simulator
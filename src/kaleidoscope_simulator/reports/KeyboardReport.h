@@ -21,6 +21,8 @@
 #include <stdint.h>
 
 #include "kaleidoscope/key_defs.h"
+#include "kaleidoscope_simulator/aux/Bitset.h"
+#include "kaleidoscope_simulator/aux/ReportPool.h"
 #include "papilio/reports/KeyboardReport_.h"
 #include "MultiReport/Keyboard.h"
 
@@ -37,7 +39,7 @@ namespace kaleidoscope {
 namespace simulator {
    
 class Simulator;
-  
+
 /// @brief An interface hat facilitates analyzing keyboard reports.
 ///
 class KeyboardReport : public papilio::KeyboardReport_ {
@@ -66,9 +68,7 @@ class KeyboardReport : public papilio::KeyboardReport_ {
       
       template<typename..._Args>
       static std::shared_ptr<KeyboardReport> create(_Args &&... args) {
-         return std::shared_ptr<KeyboardReport>{
-            new KeyboardReport{std::forward<_Args>(args)...}
-         };
+         return makePooled<KeyboardReport>(std::forward<_Args>(args)...);
       }
       
       virtual std::shared_ptr<papilio::Report_> clone() const override;
@@ -116,7 +116,38 @@ class KeyboardReport : public papilio::KeyboardReport_ {
       /// @details Empty means neither key nor modifier keycodes are active.
       ///
       virtual bool isEmpty() const override;
-      
+
+      /// @brief Retreives the set of all active keycodes, including
+      ///        modifier keycodes.
+      ///
+      KeycodeBitset getActiveKeycodeBitset() const;
+
+      /// @brief Calls a function for every active keycode, including
+      ///        modifier keycodes, in ascending order.
+      /// @details Other than getActiveKeycodes() this does not allocate.
+      /// @param f The function to call. Signature void(uint8_t keycode).
+      ///
+      template<typename _Func>
+      void forEachActiveKeycode(_Func f) const {
+         this->getActiveKeycodeBitset().forEach(
+            [&f](size_t k) { f(static_cast<uint8_t>(k)); });
+      }
+
+      /// @brief Checks if all keycodes of a set are active.
+      /// @details Further keycodes may be active as well.
+      /// @param keycodes The keycodes to check for.
+      ///
+      bool areKeycodesActive(const KeycodeBitset &keycodes) const {
+         return keycodes.isSubsetOf(this->getActiveKeycodeBitset());
+      }
+
+      /// @brief Checks if exactly the keycodes of a set are active.
+      /// @param keycodes The keycodes to check for.
+      ///
+      bool areExactlyKeycodesActive(const KeycodeBitset &keycodes) const {
+         return keycodes == this->getActiveKeycodeBitset();
+      }
+
       /// @brief Writes a formatted representation of the keyboard report 
       ///        to the simulator's log stream.
       /// @param add_indent An additional indentation string.
@@ -130,11 +161,18 @@ class KeyboardReport : public papilio::KeyboardReport_ {
       
       const ReportDataType& getReportData() const { return report_data_; }
       
-      static const char *typeString() { return "keyboard"; }
+      /// @brief The report type string.
+      /// @details Every report class has its own string object. Reports
+      ///        are therefore of the same type if and only if the addresses
+      ///        of their type strings match.
+      ///
+      static const char *typeString() { return type_string_; }
       virtual const char *getTypeString() const override { return typeString(); }
       
    private:
    
+      static const char type_string_[];
+      
       ReportDataType report_data_;
 };
 
@@ -21,6 +21,8 @@
  
 namespace kaleidoscope {
 namespace simulator {
+
+const char MouseReport::type_string_[] = "mouse";
    
    MouseReport::MouseReport()
    :  report_data_{}
@@ -42,17 +44,18 @@ namespace simulator {
 
 std::shared_ptr<papilio::Report_> MouseReport::clone() const
 {
-   return std::shared_ptr<papilio::Report_>{ new MouseReport{*this} };
+   return makePooled<MouseReport>(*this);
 }
 
 bool MouseReport::equals(const papilio::Report_ &other) const
 {
-   const MouseReport *other_mr =
-      dynamic_cast<const MouseReport *>(&other);
-      
-   if(!other_mr) { return false; }
+   // Report types are identified by the address of their type string.
+   //
+   if(other.getTypeString() != type_string_) { return false; }
+   
+   const MouseReport &other_mr = static_cast<const MouseReport &>(other);
    
-   return memcmp(&report_data_, &other_mr->report_data_, sizeof(report_data_)) == 0;
+   return memcmp(&report_data_, &other_mr.report_data_, sizeof(report_data_)) == 0;
 }
       
 bool MouseReport::areButtonsPressed(uint8_t button_state) const
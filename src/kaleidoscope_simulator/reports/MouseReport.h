@@ -19,6 +19,7 @@
 #pragma once
 
 #include "MultiReport/Mouse.h"
+#include "kaleidoscope_simulator/aux/ReportPool.h"
 #include "papilio/reports/MouseReport_.h"
 
 // Undefine some macros defined by Arduino
@@ -63,9 +64,7 @@ class MouseReport : public papilio::MouseReport_ {
       
       template<typename..._Args>
       static std::shared_ptr<MouseReport> create(_Args &&... args) {
-         return std::shared_ptr<MouseReport>{
-            new MouseReport{std::forward<_Args>(args)...}
-         };
+         return makePooled<MouseReport>(std::forward<_Args>(args)...);
       }
       
       virtual std::shared_ptr<papilio::Report_> clone() const override;
@@ -136,11 +135,18 @@ class MouseReport : public papilio::MouseReport_ {
       
       const HID_MouseReport_Data_t& getReportData() const { return report_data_; }
       
-      static const char *typeString() { return "mouse"; }
+      /// @brief The report type string.
+      /// @details Every report class has its own string object. Reports
+      ///        are therefore of the same type if and only if the addresses
+      ///        of their type strings match.
+      ///
+      static const char *typeString() { return type_string_; }
       virtual const char *getTypeString() const override { return typeString(); }
       
    private:
    
+      static const char type_string_[];
+      
       HID_MouseReport_Data_t report_data_;
 };
 
@@ -0,0 +1,169 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/reports/KeyboardReport.h"
+#include "kaleidoscope_simulator/reports/BootKeyboardReport.h"
+#include "kaleidoscope_simulator/reports/MouseReport.h"
+#include "kaleidoscope_simulator/reports/AbsoluteMouseReport.h"
+
+#include "HID-Settings.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+namespace kaleidoscope {
+namespace simulator {
+
+/// @brief A compile time list of report types.
+///
+template<typename..._ReportTypes>
+struct ReportTypeList {};
+
+/// @brief Passed to report type visitors to identify a report type.
+///
+template<typename _ReportType>
+struct ReportTypeTag {
+   typedef _ReportType Type;
+};
+
+/// @brief All report types that the simulator processes, keyed by their
+///        static member hid_report_type_.
+/// @details To support a new type of HID report, add its report class here.
+///        Report classes must provide the type ReportDataType, the static
+///        member hid_report_type_ and a constructor from const void *.
+///
+typedef ReportTypeList<
+   BootKeyboardReport,
+   KeyboardReport,
+   MouseReport,
+   AbsoluteMouseReport
+> ReportTypes;
+
+/// @brief Checks if a report id belongs to a type of HID report that is
+///        known but not yet processed by the simulator.
+/// @param id The HID report id.
+///
+inline
+bool isIgnoredHIDReportType(uint8_t id)
+{
+   return (id == HID_REPORTID_GAMEPAD)
+       || (id == HID_REPORTID_CONSUMERCONTROL)
+       || (id == HID_REPORTID_SYSTEMCONTROL);
+}
+
+/// @private
+///
+template<typename _Visitor>
+bool visitReportType(uint8_t, _Visitor &&, ReportTypeList<>)
+{
+   return false;
+}
+
+/// @private
+///
+template<typename _Visitor, typename _ReportType, typename..._MoreReportTypes>
+bool visitReportType(uint8_t id, _Visitor &&visitor,
+                     ReportTypeList<_ReportType, _MoreReportTypes...>)
+{
+   if(id == _ReportType::hid_report_type_) {
+      visitor(ReportTypeTag<_ReportType>{});
+      return true;
+   }
+   return visitReportType(id, std::forward<_Visitor>(visitor),
+                          ReportTypeList<_MoreReportTypes...>{});
+}
+
+/// @brief Calls a visitor with the tag of the report type that is
+///        associated with a HID report id.
+/// @details The visitor is typically a generic lambda that obtains the
+///        report type as typename decltype(tag)::Type.
+///
+///        @code
+///        visitReportType(id, [&](auto tag) {
+///           typedef typename decltype(tag)::Type ReportType;
+///           simulator.processReport(ReportType{data});
+///        });
+///        @endcode
+/// @param id The HID report id.
+/// @param visitor The visitor.
+/// @returns True if the report id is associated with a registered report type,
+///        false otherwise (the visitor is not called).
+///
+template<typename _Visitor>
+bool visitReportType(uint8_t id, _Visitor &&visitor)
+{
+   return visitReportType(id, std::forward<_Visitor>(visitor), ReportTypes{});
+}
+
+/// @private
+///
+template<typename _Visitor>
+bool visitReport(const papilio::Report_ &, _Visitor &&, ReportTypeList<>)
+{
+   return false;
+}
+
+/// @private
+///
+template<typename _Visitor, typename _ReportType, typename..._MoreReportTypes>
+bool visitReport(const papilio::Report_ &report, _Visitor &&visitor,
+                 ReportTypeList<_ReportType, _MoreReportTypes...>)
+{
+   if(report.getTypeString() == _ReportType::typeString()) {
+      visitor(static_cast<const _ReportType &>(report));
+      return true;
+   }
+   return visitReport(report, std::forward<_Visitor>(visitor),
+                      ReportTypeList<_MoreReportTypes...>{});
+}
+
+/// @brief Calls a visitor with a report, downcast to its actual report type.
+/// @details The report type is identified by the address of its
+///        type string, no RTTI is involved. The visitor is typically a
+///        generic lambda.
+/// @param report The report.
+/// @param visitor The visitor.
+/// @returns True if the report is of a registered report type,
+///        false otherwise (the visitor is not called).
+///
+template<typename _Visitor>
+bool visitReport(const papilio::Report_ &report, _Visitor &&visitor)
+{
+   return visitReport(report, std::forward<_Visitor>(visitor), ReportTypes{});
+}
+
+/// @brief Retreives the report data size of a HID report type.
+/// @param id The HID report id.
+/// @returns The report data size or zero if the report id is not
+///        associated with a registered report type.
+///
+inline
+size_t getReportDataSize(uint8_t id)
+{
+   size_t size = 0;
+   visitReportType(id, [&size](auto tag) {
+      size = sizeof(typename decltype(tag)::Type::ReportDataType);
+   });
+   return size;
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
@@ -25,7 +25,8 @@ namespace model01 {
    
 /// @brief A formatted string that represents the keyboard layout of 
 ///        the Keyboardio Model01.
-/// @details Use this string with the renderKeyboard(...) function.
+/// @details Use this string with the renderKeyboard(...) function
+///        or to construct a KeyboardTemplate.
 ///
 extern const char *ascii_keyboard;
 
@@ -0,0 +1,243 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/visualization/KeyboardRenderer.h"
+#include "kaleidoscope_simulator/Simulator.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace kaleidoscope {
+namespace simulator {
+
+constexpr std::size_t VisualState::max_label_length;
+constexpr std::size_t VisualState::n_keys;
+
+namespace {
+
+bool isUTF8ContinuationByte(char c)
+{
+   return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// Determines the longest prefix of a UTF-8 string that consists of at
+// most max_code_points code points. Returns its length in bytes and
+// the number of code points in n_code_points.
+//
+std::size_t utf8Prefix(const char *s, int max_code_points, int &n_code_points)
+{
+   std::size_t n_bytes = 0;
+   n_code_points = 0;
+
+   while(s[n_bytes] != '\0') {
+      if(!isUTF8ContinuationByte(s[n_bytes])) {
+         if(n_code_points == max_code_points) { break; }
+         ++n_code_points;
+      }
+      ++n_bytes;
+   }
+
+   return n_bytes;
+}
+
+} // namespace
+
+void VisualState::capture(const Simulator &simulator)
+{
+   led_colors_ = simulator.getKeyLEDFramebuffer();
+
+   std::string label;
+
+   for(std::size_t key_offset = 0; key_offset < n_keys; ++key_offset) {
+
+      label.clear();
+      simulator.getCore().getCurrentKeyLabel(
+         key_offset/kaleidoscope::Device::KeyScanner::matrix_columns,
+         key_offset%kaleidoscope::Device::KeyScanner::matrix_columns,
+         label);
+
+      auto &target = labels_[key_offset];
+      std::size_t length = std::min(label.size(), max_label_length);
+
+      // Don't cut a multibyte code point.
+      //
+      if(length < label.size()) {
+         while((length > 0) && isUTF8ContinuationByte(label[length])) {
+            --length;
+         }
+      }
+      std::memcpy(target.data(), label.data(), length);
+      target[length] = '\0';
+   }
+}
+
+   KeyboardTemplate::KeyboardTemplate(const char *template_string)
+{
+   std::string line;
+   int column = 0;
+
+   for(const char *c = template_string; *c != '\0'; ++c) {
+
+      if(*c == '\n') {
+         lines_.push_back(line);
+         line.clear();
+         column = 0;
+         continue;
+      }
+
+      if(*c == '{') {
+
+         // Check for a placeholder {NN}
+         //
+         const char *end = c + 1;
+         std::size_t key_offset = 0;
+         while((*end >= '0') && (*end <= '9')) {
+            key_offset = 10*key_offset + (*end - '0');
+            ++end;
+         }
+
+         if((end > c + 1) && (*end == '}')) {
+            int width = static_cast<int>(end - c) + 1;
+            cells_.push_back(Cell{static_cast<int>(lines_.size()), column,
+                                  width, key_offset});
+            line.append(width, ' ');
+            column += width;
+            c = end;
+            continue;
+         }
+      }
+
+      line.push_back(*c);
+
+      if(!isUTF8ContinuationByte(*c)) {
+         ++column;
+      }
+   }
+
+   if(!line.empty()) {
+      lines_.push_back(line);
+   }
+}
+
+   KeyboardRenderer::KeyboardRenderer(const KeyboardTemplate &keyboard_template,
+                                      int origin_line, int origin_column)
+   :  template_(keyboard_template),
+      origin_line_(origin_line),
+      origin_column_(origin_column),
+      displayed_labels_(keyboard_template.getCells().size()),
+      displayed_colors_(keyboard_template.getCells().size())
+{
+}
+
+void KeyboardRenderer::moveCursor(int line, int column)
+{
+   buffer_ += "\x1b[";
+   buffer_ += std::to_string(origin_line_ + line);
+   buffer_ += ';';
+   buffer_ += std::to_string(origin_column_ + column);
+   buffer_ += 'H';
+}
+
+void KeyboardRenderer::renderCell(const KeyboardTemplate::Cell &cell,
+                                  const VisualState &state)
+{
+   const uint8_t *rgb = state.getColor(cell.key_offset);
+   const char *label = state.getLabel(cell.key_offset);
+
+   this->moveCursor(cell.line, cell.column);
+
+   // Choose a foreground color that contrasts with the LED color.
+   //
+   int luminance = (299*rgb[0] + 587*rgb[1] + 114*rgb[2])/1000;
+
+   buffer_ += (luminance > 127) ? "\x1b[38;2;0;0;0m" : "\x1b[38;2;255;255;255m";
+   buffer_ += "\x1b[48;2;";
+   buffer_ += std::to_string(rgb[0]);
+   buffer_ += ';';
+   buffer_ += std::to_string(rgb[1]);
+   buffer_ += ';';
+   buffer_ += std::to_string(rgb[2]);
+   buffer_ += 'm';
+
+   // Center the label. Widths are measured in code points, like the
+   // cells of the template.
+   //
+   int length;
+   std::size_t n_bytes = utf8Prefix(label, cell.width, length);
+   int left = (cell.width - length)/2;
+   int right = cell.width - length - left;
+
+   buffer_.append(left, ' ');
+   buffer_.append(label, n_bytes);
+   buffer_.append(right, ' ');
+
+   buffer_ += "\x1b[0m";
+}
+
+void KeyboardRenderer::render(const VisualState &state, std::ostream &out)
+{
+   buffer_.clear();
+
+   if(full_redraw_) {
+      const auto &lines = template_.getLines();
+      for(std::size_t line = 0; line < lines.size(); ++line) {
+         this->moveCursor(static_cast<int>(line), 0);
+         buffer_ += lines[line];
+      }
+   }
+
+   const auto &cells = template_.getCells();
+
+   for(std::size_t cell_id = 0; cell_id < cells.size(); ++cell_id) {
+
+      const auto &cell = cells[cell_id];
+
+      if(cell.key_offset >= VisualState::n_keys) { continue; }
+
+      const char *label = state.getLabel(cell.key_offset);
+      const uint8_t *rgb = state.getColor(cell.key_offset);
+
+      auto &displayed_label = displayed_labels_[cell_id];
+      auto &displayed_color = displayed_colors_[cell_id];
+
+      if(!full_redraw_
+            && (std::strcmp(displayed_label.data(), label) == 0)
+            && (std::memcmp(displayed_color.data(), rgb, 3) == 0)) {
+         continue;
+      }
+
+      this->renderCell(cell, state);
+
+      std::memcpy(displayed_label.data(), label, displayed_label.size());
+      std::memcpy(displayed_color.data(), rgb, 3);
+   }
+
+   full_redraw_ = false;
+
+   if(buffer_.empty()) { return; }
+
+   // Park the cursor below the keyboard.
+   //
+   this->moveCursor(static_cast<int>(template_.getLines().size()), 0);
+
+   out.write(buffer_.data(), buffer_.size());
+   out.flush();
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
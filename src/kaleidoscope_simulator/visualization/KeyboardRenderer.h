@@ -0,0 +1,167 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/SimulatorCore.h"
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace kaleidoscope {
+namespace simulator {
+
+class Simulator;
+
+/// @brief A snapshot of everything that is visualized: the LED color
+///        and the label of every key.
+///
+class VisualState
+{
+   public:
+
+      /// @brief The maximum length of a key label [bytes]. Longer labels
+      ///        are truncated at a UTF-8 code point boundary.
+      ///
+      static constexpr std::size_t max_label_length = 15;
+
+      static constexpr std::size_t n_keys = std::tuple_size<KeyLEDFramebuffer>::value/3;
+
+      typedef std::array<char, max_label_length + 1> Label;
+
+      /// @brief Takes a snapshot of a simulator's visual state.
+      /// @param simulator The simulator.
+      ///
+      void capture(const Simulator &simulator);
+
+      /// @brief Retreives the label of a key.
+      /// @param key_offset The key offset (see SimulatorCore::keyIndex(...)).
+      ///
+      const char *getLabel(std::size_t key_offset) const {
+         return labels_[key_offset].data();
+      }
+
+      /// @brief Retreives the LED color of a key as packed RGB triple.
+      /// @param key_offset The key offset (see SimulatorCore::keyIndex(...)).
+      ///
+      const uint8_t *getColor(std::size_t key_offset) const {
+         return &led_colors_[3*key_offset];
+      }
+
+   private:
+
+      KeyLEDFramebuffer led_colors_ = {};
+      std::array<Label, n_keys> labels_ = {};
+};
+
+/// @brief A keyboard template that has been parsed into a table of cells.
+/// @details The template is a text with placeholders of the form {NN}
+///        where NN is a key offset (see SimulatorCore::keyIndex(...)),
+///        e.g. keyboardio::model01::ascii_keyboard. Every placeholder
+///        defines a cell of four characters that shows the key's label
+///        on a background of the key's LED color. Text is expected to be
+///        UTF-8 encoded. Every code point is assumed to occupy one
+///        terminal column.
+///
+class KeyboardTemplate
+{
+   public:
+
+      /// @brief A cell that is associated with a key.
+      ///
+      struct Cell {
+         int line;       ///< Zero based line of the template
+         int column;     ///< Zero based column (in code points) of the template
+         int width;      ///< The cell width in terminal columns
+         std::size_t key_offset;
+      };
+
+      /// @brief Constructor.
+      /// @param template_string The template text.
+      ///
+      KeyboardTemplate(const char *template_string);
+
+      /// @brief The template text with all placeholders replaced by blanks.
+      ///
+      const std::vector<std::string> &getLines() const { return lines_; }
+
+      /// @brief The cells of the template.
+      ///
+      const std::vector<Cell> &getCells() const { return cells_; }
+
+   private:
+
+      std::vector<std::string> lines_;
+      std::vector<Cell> cells_;
+};
+
+/// @brief Renders a keyboard template to a terminal.
+/// @details The first frame is rendered in full. Subsequent frames only
+///        update the cells whose label or color changed, using
+///        ANSI escape sequences for cursor positioning. Every frame is
+///        written with a single write operation.
+///
+class KeyboardRenderer
+{
+   public:
+
+      /// @brief Constructor.
+      /// @param keyboard_template The parsed template. Must outlive the renderer.
+      /// @param origin_line The one based terminal line of the template's upper left corner.
+      /// @param origin_column The one based terminal column of the template's
+      ///        upper left corner.
+      ///
+      KeyboardRenderer(const KeyboardTemplate &keyboard_template,
+                       int origin_line = 1, int origin_column = 1);
+
+      /// @brief Renders a frame.
+      /// @param state The visual state to render.
+      /// @param out The output stream (the terminal).
+      ///
+      void render(const VisualState &state, std::ostream &out);
+
+      /// @brief Enforces the next frame to be rendered in full,
+      ///        e.g. after the screen was cleared.
+      ///
+      void invalidate() { full_redraw_ = true; }
+
+   private:
+
+      void renderCell(const KeyboardTemplate::Cell &cell, const VisualState &state);
+      void moveCursor(int line, int column);
+
+   private:
+
+      const KeyboardTemplate &template_;
+      int origin_line_;
+      int origin_column_;
+
+      bool full_redraw_ = true;
+
+      // What is currently displayed, per cell.
+      //
+      std::vector<VisualState::Label> displayed_labels_;
+      std::vector<std::array<uint8_t, 3>> displayed_colors_;
+
+      std::string buffer_;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope
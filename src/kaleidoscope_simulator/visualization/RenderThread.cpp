@@ -0,0 +1,174 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kaleidoscope_simulator/visualization/RenderThread.h"
+#include "kaleidoscope_simulator/Simulator.h"
+#include "kaleidoscope_simulator/aux/BackgroundThreads.h"
+
+namespace kaleidoscope {
+namespace simulator {
+
+   RenderThread::RenderThread(KeyboardRenderer &renderer, std::ostream &out,
+                              double frames_per_second)
+   :  renderer_(renderer),
+      out_(out.rdbuf()),
+      frame_period_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                       std::chrono::duration<double>(1.0/frames_per_second))),
+      staging_state_(new VisualState),
+      log_buffer_(*this),
+      published_state_(new VisualState),
+      render_state_(new VisualState)
+{
+   thread_ = std::thread(&RenderThread::run, this);
+   registerBackgroundThread("RenderThread");
+}
+
+RenderThread::~RenderThread()
+{
+   this->stop();
+}
+
+RenderThread::LogBuffer::int_type RenderThread::LogBuffer::overflow(int_type c)
+{
+   if(!traits_type::eq_int_type(c, traits_type::eof())) {
+      char ch = traits_type::to_char_type(c);
+      this->xsputn(&ch, 1);
+   }
+   return traits_type::not_eof(c);
+}
+
+std::streamsize RenderThread::LogBuffer::xsputn(const char *s, std::streamsize n)
+{
+   std::lock_guard<std::mutex> lock(render_thread_.mutex_);
+   render_thread_.log_text_.append(s, n);
+   return n;
+}
+
+void RenderThread::installLog(std::ostream &stream)
+{
+   if(log_stream_) {
+      log_stream_->rdbuf(log_stream_buffer_);
+   }
+
+   log_stream_ = &stream;
+   log_stream_buffer_ = stream.rdbuf(&log_buffer_);
+}
+
+void RenderThread::publish(const Simulator &simulator)
+{
+   simulator_ = &simulator;
+
+   // Don't capture more often than states are rendered.
+   //
+   if(!pickup_done_.load(std::memory_order_acquire)) { return; }
+
+   staging_state_->capture(simulator);
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::swap(staging_state_, published_state_);
+      state_pending_ = true;
+   }
+
+   pickup_done_.store(false, std::memory_order_release);
+}
+
+void RenderThread::renderLatest()
+{
+   bool render_state;
+   
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      
+      render_state = state_pending_;
+      if(state_pending_) {
+         std::swap(render_state_, published_state_);
+         state_pending_ = false;
+      }
+      
+      std::swap(log_text_, log_text_to_write_);
+   }
+
+   if(render_state) {
+      pickup_done_.store(true, std::memory_order_release);
+      state_rendered_ = true;
+   }
+   
+   if(!log_text_to_write_.empty()) {
+      
+      // The cursor is parked below the keyboard. The log text may scroll 
+      // the terminal. A full redraw paints the keyboard over it.
+      //
+      out_.write(log_text_to_write_.data(), log_text_to_write_.size());
+      log_text_to_write_.clear();
+      renderer_.invalidate();
+   }
+   
+   if(state_rendered_) {
+      renderer_.render(*render_state_, out_);
+   }
+   else {
+      out_.flush();
+   }
+}
+
+void RenderThread::run()
+{
+   auto next_frame = std::chrono::steady_clock::now();
+
+   while(!stop_requested_.load(std::memory_order_acquire)) {
+      this->renderLatest();
+
+      // Drop frames instead of catching up if rendering fell behind.
+      //
+      next_frame += frame_period_;
+      auto now = std::chrono::steady_clock::now();
+      if(next_frame < now) { next_frame = now; }
+
+      std::this_thread::sleep_until(next_frame);
+   }
+}
+
+void RenderThread::stop()
+{
+   if(!thread_.joinable()) { return; }
+
+   stop_requested_.store(true, std::memory_order_release);
+   thread_.join();
+   
+   unregisterBackgroundThread("RenderThread");
+   
+   if(log_stream_) {
+      log_stream_->rdbuf(log_stream_buffer_);
+      log_stream_ = nullptr;
+   }
+   
+   // publish(...) drops states while a pickup is pending. Capture 
+   // the current state, so the final frame is not stale. The render thread
+   // has terminated, so we can access its state.
+   //
+   if(simulator_) {
+      published_state_->capture(*simulator_);
+      state_pending_ = true;
+   }
+
+   this->renderLatest();
+}
+
+} // namespace simulator
+} // namespace kaleidoscope
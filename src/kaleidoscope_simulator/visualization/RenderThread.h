@@ -0,0 +1,165 @@
+/* -*- mode: c++ -*-
+ * Kaleidoscope-Simulator -- A C++ testing API for the Kaleidoscope keyboard
+ *                         firmware.
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "kaleidoscope_simulator/visualization/KeyboardRenderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+namespace kaleidoscope {
+namespace simulator {
+
+class Simulator;
+
+/// @brief Renders a keyboard on a separate thread at a fixed frame rate.
+/// @details The simulation publishes its visual state (see publish(...)),
+///        the render thread picks up the most recently published state
+///        once per frame. Publishing only swaps buffers and never waits
+///        for terminal output. Slow terminal I/O therefore does not
+///        affect the simulation's timing.
+///
+///        To keep the cost per scan cycle low, a new snapshot is only
+///        captured when the render thread has picked up the previous one.
+///        A rendered frame is therefore at most one frame period old.
+///
+///        Frames must not interleave with other output to the terminal,
+///        e.g. the simulator's log. Use installLog(...) to make such output
+///        part of the frames.
+///
+///        Until stop() is called, Simulator::checkpoint() and 
+///        ParallelTestRunner::run(...) do not fork, as fork() does not 
+///        copy the render thread.
+///
+class RenderThread
+{
+   public:
+
+      /// @brief Constructor. Starts the render thread.
+      /// @param renderer The renderer. Must outlive the render thread.
+      ///        It must not be used by any other thread.
+      /// @param out The output stream (the terminal).
+      /// @param frames_per_second The frame rate.
+      ///
+      RenderThread(KeyboardRenderer &renderer, std::ostream &out,
+                   double frames_per_second = 30.0);
+
+      /// @brief Destructor. Stops the render thread (see stop()).
+      ///
+      ~RenderThread();
+
+      RenderThread(const RenderThread &) = delete;
+      RenderThread &operator=(const RenderThread &) = delete;
+
+      /// @brief Publishes the visual state of a simulator.
+      /// @details Call this from the simulation thread, e.g. in the
+      ///        cycle callback of runRealtime(...).
+      /// @param simulator The simulator.
+      ///
+      void publish(const Simulator &simulator);
+
+      /// @brief Stops the render thread.
+      /// @details Captures the current state of the simulator that was
+      ///        most recently passed to publish(...) and renders it as 
+      ///        the final frame. Call this from the simulation thread.
+      ///        A stream that was passed to installLog(...) is restored.
+      ///
+      void stop();
+
+      /// @brief Routes the output of a stream through the render thread.
+      /// @details Text written to the stream, e.g. std::cout which
+      ///        receives the log of Simulator::getInstance(), is collected. 
+      ///        The render thread writes it before the next frame, followed 
+      ///        by a full redraw of the keyboard, as the text may have
+      ///        scrolled the terminal. Frames themselves are written to the
+      ///        stream buffer the output stream of the render thread had 
+      ///        on construction, even if that stream is the one installed.
+      /// @param stream The stream. Its stream buffer is restored by stop().
+      ///
+      void installLog(std::ostream &stream);
+
+   private:
+
+      // Collects text written to an installed log stream.
+      //
+      class LogBuffer : public std::streambuf
+      {
+         public:
+
+            LogBuffer(RenderThread &render_thread) : render_thread_(render_thread) {}
+
+         protected:
+
+            virtual int_type overflow(int_type c) override;
+            virtual std::streamsize xsputn(const char *s, std::streamsize n) override;
+
+         private:
+
+            RenderThread &render_thread_;
+      };
+
+      void run();
+      void renderLatest();
+
+   private:
+
+      KeyboardRenderer &renderer_;
+      
+      // Writes to the stream buffer of the output stream 
+      // that was passed to the constructor.
+      //
+      std::ostream out_;
+      std::chrono::steady_clock::duration frame_period_;
+
+      // Owned by the simulation thread.
+      //
+      std::unique_ptr<VisualState> staging_state_;
+      const Simulator *simulator_ = nullptr;
+      
+      LogBuffer log_buffer_;
+      std::ostream *log_stream_ = nullptr;
+      std::streambuf *log_stream_buffer_ = nullptr;
+
+      // Shared, guarded by mutex_.
+      //
+      std::mutex mutex_;
+      std::unique_ptr<VisualState> published_state_;
+      bool state_pending_ = false;
+      std::string log_text_;
+
+      // Owned by the render thread.
+      //
+      std::unique_ptr<VisualState> render_state_;
+      bool state_rendered_ = false;
+      std::string log_text_to_write_;
+
+      std::atomic<bool> pickup_done_{true};
+      std::atomic<bool> stop_requested_{false};
+
+      std::thread thread_;
+};
+
+} // namespace simulator
+} // namespace kaleidoscope